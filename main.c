@@ -3,11 +3,36 @@
 #endif
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_mixer.h>
+#define GL_GLEXT_PROTOTYPES 1 // buffer objects (GL 1.5)
 #include <SDL2/SDL_opengl.h>
 #include <SDL2/SDL_ttf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <dirent.h>
+#include <dlfcn.h>
+#include <linux/input.h>
+#include <sys/inotify.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "pomo_status.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -18,15 +43,33 @@
 #define wh 200
 #define ww 200
 
+#define SHAKE_AFTER_SEC 300.0 // paused this long in a work session -> shake
+
 #ifdef __APPLE__
 #define FONT_PATH "/System/Library/Fonts/Supplemental/Arial.ttf"
 #else
 #define FONT_PATH "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf"
 #endif
 #define CONFIG_PATH "pomo.cfg"
+#define SOUNDTRACK_PATH "res/timer.mp3"
+#define AUDIO_CACHE_MAX_MB 1024
 #define STREAK_PATH "streak.txt"
+#define JOURNAL_PATH "streak.journal"
 #include <time.h>
 
+// --verbose: what got loaded and what happened along the way, on stderr.
+// The GUI is quiet on stdout otherwise.
+bool verbose = false;
+
+void verbose_log(const char *fmt, ...) {
+  if (!verbose)
+    return;
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+}
+
 typedef enum { w, b } State;
 
 typedef struct {
@@ -39,178 +82,577 @@ typedef struct {
   int opacity;         // 0-100
   int volume;          // 0-128
   int focus_threshold; // seconds
+  int audio_cache_mb;  // max decoded soundtrack in memory, 0 = always stream
+  int work_chime;      // chime volumes 0-128, 0 = silent
+  int break_chime;
+  int long_break_chime;
+  int suspend_policy; // SuspendPolicy
   int x, y;
 } Config;
 
-#define MAX_HISTORY 365
+// Sessions per local day, indexed by day number (days since 1970-01-01).
+// Storage is a growable array of fixed-size chunks, so lookups and appends
+// are O(1) and there's no cap on how far back history goes.
+#define HISTORY_CHUNK_DAYS 64
+#define NO_DAY INT_MIN
 
 typedef struct {
-  char date[11];
-  int sessions;
-} HistoryEntry;
+  int **chunks;   // chunks[i] covers days (base_chunk + i) * CHUNK_DAYS ...
+  int base_chunk; // chunk number of chunks[0]
+  int num_chunks;
+  int first_day, last_day; // range holding sessions, NO_DAY when empty
+} History;
 
 typedef struct {
-  char last_date[11]; // YYYY-MM-DD
+  int last_day; // day number of the last session, NO_DAY if none
   int daily_sessions;
   int consecutive_days;
-  HistoryEntry history[MAX_HISTORY];
-  int history_count;
+  History history;
+  unsigned long journal_seq; // last journal record folded into streak.txt
+  unsigned revision;         // bumped on every change, not persisted
 } Streak;
 
+// The streak window is pre-rendered into a target texture and only rebuilt
+// when the streak changes or the local date rolls over.
+typedef struct {
+  SDL_Texture *target; // NULL if the renderer can't do render targets
+  SDL_Texture *days[7];
+  SDL_Texture *months[12];
+  SDL_Texture *less, *more;
+  unsigned built_revision;
+  time_t next_midnight;
+  bool stale; // target contents need rebuilding
+  bool dirty; // window needs presenting
+} StreakView;
+
+// Small animation timeline: a fixed slot per animation, each a tween with
+// easing and its own frame rate. The main loop asks it when the next frame
+// is due, so only running animations keep the loop awake.
+typedef enum {
+  ANIM_PULSE,   // paused text alpha
+  ANIM_SHAKE_X, // paused-too-long shake, drawn inside the framebuffer
+  ANIM_SHAKE_Y,
+  ANIM_SNAP_X,  // window glide to the nearest corner
+  ANIM_SNAP_Y,
+  ANIM_COUNT
+} AnimId;
+
+typedef enum {
+  EASE_LINEAR,
+  EASE_OUT_CUBIC,
+  EASE_WAVE, // 0 -> 1 -> 0 over one period, for looping animations
+} Easing;
+
+typedef struct {
+  bool active;
+  bool loop;
+  uint32_t start;    // ms, SDL_GetTicks
+  uint32_t duration; // ms, one period for looping tweens
+  float from, to;
+  Easing ease;
+  int fps;
+} Tween;
+
+typedef struct {
+  Tween tweens[ANIM_COUNT];
+} Timeline;
+
+#define NUM_SETTINGS 9
+
+// One cached texture per settings row, re-rendered only when the row's text
+// (which embeds its value) or its selection state changes.
+typedef struct {
+  SDL_Texture *tex;
+  int w, h;
+  char text[128];
+  bool selected;
+} SettingsRow;
+
+typedef struct {
+  SDL_Texture *title;
+  int title_w, title_h;
+  SettingsRow rows[NUM_SETTINGS];
+  bool dirty; // present again on the next render_settings
+} SettingsView;
+
 typedef struct {
   State state;
   double sec_remain;
   bool paused;
-  uint32_t last_frame_time;
+  double deadline;  // mono_now() at which the running phase ends
+  double paused_at; // mono_now() when the timer was paused
   double pause_duration;
-  int base_x, base_y;
   bool is_shaking;
+  Timeline anim;
   Mix_Music *music;
-  double elapsed_work;
-  double elapsed_break;
   Config config;
   SDL_Window *settings_win;
   SDL_Renderer *settings_ren;
+  SettingsView settings_view;
   int session_count;
   int selected_setting;
   bool is_away;
+  bool user_idle; // last word from the idle monitor, input clears it
   Streak streak;
   SDL_Window *streak_win;
   SDL_Renderer *streak_ren;
+  StreakView streak_view;
   int settings_scroll_y;
+  double suspend_offset; // suspend_clock() - mono_now() at the last check
+  bool audio_open;
+  uint32_t silent_since;   // ticks when the music last went quiet, 0 if not
+  uint32_t audio_retry_at; // don't try opening the device before this
+  int view; // what the main window shows: 0 the pomodoro, n countdown n-1
 } Timer;
 
+// Main-window text is composed from a glyph atlas baked once at startup, so
+// the countdown ticking never touches FreeType or uploads a texture.
+#define ATLAS_W 512
+#define ATLAS_FIRST_CHAR 32
+#define ATLAS_LAST_CHAR 126
+#define ATLAS_MAX_TEXT 64
+
+typedef struct {
+  float u0, v0, u1, v1;
+  int w, h;    // quad size in pixels, 0 if the glyph has no image
+  int advance; // pen advance in pixels
+} AtlasGlyph;
+
+typedef struct {
+  AtlasGlyph glyphs[ATLAS_LAST_CHAR - ATLAS_FIRST_CHAR + 1];
+  int height;
+  bool loaded;
+} AtlasFont;
+
 typedef struct {
   GLuint texture;
-  int w, h;
-  char text[32];
-  SDL_Color color;
-} CachedText;
-
-void draw_filled_circle(float x, float y, float rad, float r, float g, float b,
-                        float a) {
-  glBegin(GL_TRIANGLE_FAN);
-  glColor4f(r, g, b, a);
-  glVertex2f(x, y);
-  int segments = 40;
-  for (int i = 0; i <= segments; i++) {
-    float angle = 2.0f * M_PI * i / segments;
-    glVertex2f(x + cos(angle) * rad, y + sin(angle) * rad);
+  AtlasFont large; // countdown: digits and colon
+  AtlasFont small; // labels: printable ASCII
+} GlyphAtlas;
+
+// Ring geometry is built once into a static VBO: the background disc, the
+// full ring strip and a round cap, all from one precomputed unit circle. The
+// progress arc is just a prefix of the ring strip, so per frame we only pick
+// a draw range instead of recomputing vertices.
+#define RING_SEGMENTS 360 // one per degree
+#define CAP_SEGMENTS 24
+#define DISC_R 100.0f
+#define RING_OUTER_R 80.0f
+#define RING_INNER_R 75.0f
+
+// angle i (in 1/RING_SEGMENTS turns) measured clockwise from 12 o'clock
+float unit_cos[RING_SEGMENTS + 1];
+float unit_sin[RING_SEGMENTS + 1];
+
+typedef struct {
+  GLuint vbo;
+  GLint disc_first, disc_count; // triangle fan
+  GLint ring_first, ring_count; // triangle strip, 2 verts per segment edge
+  GLint cap_first, cap_count;   // triangle fan around the origin
+  GLint quad_first;             // full window, 4 verts, for the shader
+  GLuint program;               // SDF ring shader, 0 -> fixed function
+  GLint u_progress, u_color;
+} RingGeometry;
+
+// The shader draws disc, back ring, progress arc and round caps in a single
+// full-window quad, with coverage from signed distances instead of MSAA.
+const char *ring_vs_src = "#version 110\n"
+                          "varying vec2 pos;\n"
+                          "void main() {\n"
+                          "  // the quad stays put, the ring moves with the "
+                          "modelview translation\n"
+                          "  pos = gl_Vertex.xy - gl_ModelViewMatrix[3].xy;\n"
+                          "  gl_Position = gl_ProjectionMatrix * gl_Vertex;\n"
+                          "}\n";
+
+const char *ring_fs_src =
+    "#version 110\n"
+    "uniform vec2 center;\n"
+    "uniform vec3 radii; // disc, ring outer, ring inner\n"
+    "uniform float progress;\n"
+    "uniform vec4 clear_color, base_color, color;\n"
+    "varying vec2 pos;\n"
+    "float cover(float d) { return clamp(0.5 - d, 0.0, 1.0); }\n"
+    "void main() {\n"
+    "  vec2 p = pos - center;\n"
+    "  float r = length(p);\n"
+    "  float mid = (radii.y + radii.z) * 0.5;\n"
+    "  float half_w = (radii.y - radii.z) * 0.5;\n"
+    "  float ring_d = abs(r - mid) - half_w;\n"
+    "  vec4 col = mix(clear_color, base_color, cover(r - radii.x));\n"
+    "  col = mix(col, base_color, cover(ring_d));\n"
+    "  // clockwise from the top, y points down\n"
+    "  float a = atan(p.x, -p.y);\n"
+    "  if (a < 0.0) a += 6.28318531;\n"
+    "  float end = progress * 6.28318531;\n"
+    "  vec2 c0 = vec2(0.0, -mid);\n"
+    "  vec2 c1 = mid * vec2(sin(end), -cos(end));\n"
+    "  float d = min(length(p - c0), length(p - c1)) - half_w;\n"
+    "  if (a <= end) d = min(d, ring_d);\n"
+    "  gl_FragColor = mix(col, color, cover(d));\n"
+    "}\n";
+
+void init_unit_circle(void) {
+  for (int i = 0; i <= RING_SEGMENTS; i++) {
+    double rad = (i * 360.0 / RING_SEGMENTS - 90.0) * M_PI / 180.0;
+    unit_cos[i] = (float)cos(rad);
+    unit_sin[i] = (float)sin(rad);
   }
-  glEnd();
 }
 
-void draw_ring_segment(float x, float y, float outerR, float innerR,
-                       float start_angle, float end_angle, float r, float g,
-                       float b, float a) {
-  glBegin(GL_TRIANGLE_STRIP);
-  glColor4f(r, g, b, a);
-  int segments = (int)(fabs(end_angle - start_angle) / 2.0f) + 10;
-  if (segments < 10)
-    segments = 10;
+void init_ring_geometry(RingGeometry *geo) {
+  static GLfloat verts[2 * ((RING_SEGMENTS + 2) + 2 * (RING_SEGMENTS + 1) +
+                            (CAP_SEGMENTS + 2) + 4)];
+  float cx = ww / 2.0f, cy = wh / 2.0f;
+  float cap_r = (RING_OUTER_R - RING_INNER_R) / 2.0f;
+  int n = 0;
+
+  init_unit_circle();
+
+  geo->disc_first = n;
+  verts[2 * n] = cx;
+  verts[2 * n + 1] = cy;
+  n++;
+  for (int i = 0; i <= RING_SEGMENTS; i++, n++) {
+    verts[2 * n] = cx + unit_cos[i] * DISC_R;
+    verts[2 * n + 1] = cy + unit_sin[i] * DISC_R;
+  }
+  geo->disc_count = n - geo->disc_first;
+
+  geo->ring_first = n;
+  for (int i = 0; i <= RING_SEGMENTS; i++) {
+    verts[2 * n] = cx + unit_cos[i] * RING_OUTER_R;
+    verts[2 * n + 1] = cy + unit_sin[i] * RING_OUTER_R;
+    n++;
+    verts[2 * n] = cx + unit_cos[i] * RING_INNER_R;
+    verts[2 * n + 1] = cy + unit_sin[i] * RING_INNER_R;
+    n++;
+  }
+  geo->ring_count = n - geo->ring_first;
+
+  geo->cap_first = n;
+  verts[2 * n] = 0;
+  verts[2 * n + 1] = 0;
+  n++;
+  for (int i = 0; i <= CAP_SEGMENTS; i++, n++) {
+    int k = i * (RING_SEGMENTS / CAP_SEGMENTS);
+    verts[2 * n] = unit_cos[k] * cap_r;
+    verts[2 * n + 1] = unit_sin[k] * cap_r;
+  }
+  geo->cap_count = n - geo->cap_first;
+
+  geo->quad_first = n;
+  GLfloat quad[8] = {0, 0, ww, 0, ww, wh, 0, wh};
+  memcpy(&verts[2 * n], quad, sizeof(quad));
+  n += 4;
+
+  glGenBuffers(1, &geo->vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, geo->vbo);
+  glBufferData(GL_ARRAY_BUFFER, n * 2 * sizeof(GLfloat), verts,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GLuint compile_shader(GLenum type, const char *src) {
+  GLuint sh = glCreateShader(type);
+  if (!sh)
+    return 0;
+  glShaderSource(sh, 1, &src, NULL);
+  glCompileShader(sh);
+  GLint ok = 0;
+  glGetShaderiv(sh, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    char log[512];
+    glGetShaderInfoLog(sh, sizeof(log), NULL, log);
+    fprintf(stderr, "Ring shader compile failed: %s\n", log);
+    glDeleteShader(sh);
+    return 0;
+  }
+  return sh;
+}
 
-  for (int i = 0; i <= segments; i++) {
-    float angle =
-        start_angle + (end_angle - start_angle) * (i / (float)segments);
-    float rad = (angle - 90.0f) * M_PI / 180.0f;
-    glVertex2f(x + cos(rad) * outerR, y + sin(rad) * outerR);
-    glVertex2f(x + cos(rad) * innerR, y + sin(rad) * innerR);
+// Returns false (and leaves geo->program at 0) if GLSL isn't available, in
+// which case the VBO path is used.
+bool init_ring_shader(RingGeometry *geo) {
+  const char *glsl = (const char *)glGetString(GL_SHADING_LANGUAGE_VERSION);
+  if (!glsl)
+    return false;
+
+  GLuint vs = compile_shader(GL_VERTEX_SHADER, ring_vs_src);
+  GLuint fs = compile_shader(GL_FRAGMENT_SHADER, ring_fs_src);
+  if (!vs || !fs) {
+    if (vs)
+      glDeleteShader(vs);
+    if (fs)
+      glDeleteShader(fs);
+    return false;
+  }
+  GLuint prog = glCreateProgram();
+  glAttachShader(prog, vs);
+  glAttachShader(prog, fs);
+  glLinkProgram(prog);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  GLint ok = 0;
+  glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+  if (!ok) {
+    char log[512];
+    glGetProgramInfoLog(prog, sizeof(log), NULL, log);
+    fprintf(stderr, "Ring shader link failed: %s\n", log);
+    glDeleteProgram(prog);
+    return false;
   }
-  glEnd();
 
-  // round round caps :3
-  float mid_r = (outerR + innerR) / 2.0f;
-  float cap_r = (outerR - innerR) / 2.0f;
+  // everything but progress and its colour is fixed for the window
+  glUseProgram(prog);
+  glUniform2f(glGetUniformLocation(prog, "center"), ww / 2.0f, wh / 2.0f);
+  glUniform3f(glGetUniformLocation(prog, "radii"), DISC_R, RING_OUTER_R,
+              RING_INNER_R);
+  glUniform4f(glGetUniformLocation(prog, "clear_color"), 0.10f, 0.12f, 0.18f,
+              1.0f);
+  glUniform4f(glGetUniformLocation(prog, "base_color"), 0.15f, 0.17f, 0.25f,
+              1.0f);
+  glUseProgram(0);
+  geo->u_progress = glGetUniformLocation(prog, "progress");
+  geo->u_color = glGetUniformLocation(prog, "color");
+  geo->program = prog;
+  return true;
+}
 
-  float start_rad = (start_angle - 90.0f) * M_PI / 180.0f;
-  draw_filled_circle(x + cos(start_rad) * mid_r, y + sin(start_rad) * mid_r,
-                     cap_r, r, g, b, a);
-  float end_rad = (end_angle - 90.0f) * M_PI / 180.0f;
-  draw_filled_circle(x + cos(end_rad) * mid_r, y + sin(end_rad) * mid_r, cap_r,
-                     r, g, b, a);
+void free_ring_geometry(RingGeometry *geo) {
+  if (geo->program)
+    glDeleteProgram(geo->program);
+  geo->program = 0;
+  if (geo->vbo)
+    glDeleteBuffers(1, &geo->vbo);
+  geo->vbo = 0;
 }
 
-void update_cached_text(TTF_Font *font, CachedText *cache, const char *text,
-                        SDL_Color color) {
-  if (!font)
-    return;
-  if (cache->texture != 0 && strcmp(cache->text, text) == 0 &&
-      cache->color.r == color.r && cache->color.g == color.g &&
-      cache->color.b == color.b) {
+void draw_cap(const RingGeometry *geo, int i) {
+  float mid_r = (RING_OUTER_R + RING_INNER_R) / 2.0f;
+  glPushMatrix();
+  glTranslatef(ww / 2.0f + unit_cos[i] * mid_r, wh / 2.0f + unit_sin[i] * mid_r,
+               0);
+  glDrawArrays(GL_TRIANGLE_FAN, geo->cap_first, geo->cap_count);
+  glPopMatrix();
+}
+
+// progress is 0..1 of the full ring, starting at the top going clockwise
+void draw_ring_geometry(const RingGeometry *geo, float progress, float r,
+                        float g, float b) {
+  glBindBuffer(GL_ARRAY_BUFFER, geo->vbo);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(2, GL_FLOAT, 0, (const GLvoid *)0);
+
+  if (geo->program) {
+    glUseProgram(geo->program);
+    glUniform1f(geo->u_progress, progress < 0 ? 0 : progress);
+    glUniform4f(geo->u_color, r, g, b, 1.0f);
+    glDrawArrays(GL_TRIANGLE_FAN, geo->quad_first, 4);
+    glUseProgram(0);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     return;
   }
-  if (cache->texture != 0) {
-    glDeleteTextures(1, &cache->texture);
-    cache->texture = 0;
+
+  // Solid background disc + back ringy (closed, so no caps needed)
+  glColor4f(0.15f, 0.17f, 0.25f, 1.0f);
+  glDrawArrays(GL_TRIANGLE_FAN, geo->disc_first, geo->disc_count);
+  glDrawArrays(GL_TRIANGLE_STRIP, geo->ring_first, geo->ring_count);
+
+  // progress arc is the first `end` segments of the same strip
+  int end = (int)(progress * RING_SEGMENTS + 0.5f);
+  if (end < 0)
+    end = 0;
+  if (end > RING_SEGMENTS)
+    end = RING_SEGMENTS;
+  glColor4f(r, g, b, 1.0f);
+  if (end > 0)
+    glDrawArrays(GL_TRIANGLE_STRIP, geo->ring_first, 2 * (end + 1));
+
+  // round round caps :3
+  draw_cap(geo, 0);
+  draw_cap(geo, end);
+
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+typedef struct {
+  AtlasFont *font;
+  char ch;
+  SDL_Surface *surf;
+  int x, y;
+} AtlasSlot;
+
+// Renders every glyph of `chars` in white so it can be tinted at draw time.
+int collect_atlas_glyphs(TTF_Font *font, AtlasFont *af, const char *chars,
+                         AtlasSlot *slots, int n) {
+  SDL_Color white = {255, 255, 255, 255};
+  af->height = TTF_FontHeight(font);
+  for (const char *c = chars; *c; c++) {
+    AtlasGlyph *g = &af->glyphs[*c - ATLAS_FIRST_CHAR];
+    int minx, maxx, miny, maxy;
+    if (TTF_GlyphMetrics(font, (Uint8)*c, &minx, &maxx, &miny, &maxy,
+                         &g->advance) != 0)
+      continue;
+    // same code path as a one-char TTF_RenderText, so placing these at the
+    // pen position lays text out the way the old per-string textures did
+    char str[2] = {*c, 0};
+    SDL_Surface *s = TTF_RenderText_Blended(font, str, white);
+    if (!s)
+      continue; // e.g. space: advance only
+    SDL_Surface *opt = SDL_ConvertSurfaceFormat(s, SDL_PIXELFORMAT_ABGR8888, 0);
+    SDL_FreeSurface(s);
+    if (!opt)
+      continue;
+    slots[n].font = af;
+    slots[n].ch = *c;
+    slots[n].surf = opt;
+    n++;
   }
-  SDL_Surface *surface = TTF_RenderText_Blended(font, text, color);
-  if (!surface)
-    return;
+  af->loaded = true;
+  return n;
+}
 
-  SDL_Surface *opt =
-      SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ABGR8888, 0);
-  SDL_FreeSurface(surface);
-  if (!opt)
-    return;
+// Renders and packs the glyphs into one sheet and fills in their metrics.
+// No GL in here, so it can run on the asset thread; upload_glyph_atlas()
+// does the rest on the GL thread.
+SDL_Surface *pack_glyph_atlas(GlyphAtlas *atlas, TTF_Font *large,
+                              TTF_Font *small) {
+  static AtlasSlot slots[2 * (ATLAS_LAST_CHAR - ATLAS_FIRST_CHAR + 1)];
+  char printable[ATLAS_LAST_CHAR - ATLAS_FIRST_CHAR + 2];
+  int n = 0;
+
+  for (int c = ATLAS_FIRST_CHAR; c <= ATLAS_LAST_CHAR; c++)
+    printable[c - ATLAS_FIRST_CHAR] = (char)c;
+  printable[ATLAS_LAST_CHAR - ATLAS_FIRST_CHAR + 1] = 0;
+
+  if (large)
+    n = collect_atlas_glyphs(large, &atlas->large, "0123456789:-", slots, n);
+  if (small)
+    n = collect_atlas_glyphs(small, &atlas->small, printable, slots, n);
+  if (n == 0)
+    return NULL;
+
+  // shelf packing, 1px gutter so linear filtering doesn't bleed
+  int x = 1, y = 1, row_h = 0;
+  for (int i = 0; i < n; i++) {
+    SDL_Surface *gs = slots[i].surf;
+    if (x + gs->w + 1 > ATLAS_W) {
+      x = 1;
+      y += row_h + 1;
+      row_h = 0;
+    }
+    slots[i].x = x;
+    slots[i].y = y;
+    x += gs->w + 1;
+    if (gs->h > row_h)
+      row_h = gs->h;
+  }
+  int atlas_h = 1;
+  while (atlas_h < y + row_h + 1)
+    atlas_h *= 2;
+
+  SDL_Surface *sheet = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_W, atlas_h, 32,
+                                                      SDL_PIXELFORMAT_ABGR8888);
+  for (int i = 0; i < n; i++) {
+    SDL_Surface *gs = slots[i].surf;
+    if (sheet) {
+      SDL_Rect dst = {slots[i].x, slots[i].y, gs->w, gs->h};
+      SDL_SetSurfaceBlendMode(gs, SDL_BLENDMODE_NONE);
+      SDL_BlitSurface(gs, NULL, sheet, &dst);
+    }
+    AtlasGlyph *g = &slots[i].font->glyphs[slots[i].ch - ATLAS_FIRST_CHAR];
+    g->w = gs->w;
+    g->h = gs->h;
+    g->u0 = slots[i].x / (float)ATLAS_W;
+    g->v0 = slots[i].y / (float)atlas_h;
+    g->u1 = (slots[i].x + gs->w) / (float)ATLAS_W;
+    g->v1 = (slots[i].y + gs->h) / (float)atlas_h;
+    SDL_FreeSurface(gs);
+  }
+  return sheet;
+}
 
-  glGenTextures(1, &cache->texture);
-  glBindTexture(GL_TEXTURE_2D, cache->texture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, opt->w, opt->h, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, opt->pixels);
+// Takes ownership of sheet.
+bool upload_glyph_atlas(GlyphAtlas *atlas, SDL_Surface *sheet) {
+  if (!sheet)
+    return false;
+  int atlas_h = sheet->h;
+  glGenTextures(1, &atlas->texture);
+  glBindTexture(GL_TEXTURE_2D, atlas->texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ATLAS_W, atlas_h, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, sheet->pixels);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  SDL_FreeSurface(sheet);
+  return true;
+}
 
-  cache->w = opt->w;
-  cache->h = opt->h;
-  strncpy(cache->text, text, sizeof(cache->text) - 1);
-  cache->color = color;
-  SDL_FreeSurface(opt);
+void free_glyph_atlas(GlyphAtlas *atlas) {
+  if (atlas->texture)
+    glDeleteTextures(1, &atlas->texture);
+  atlas->texture = 0;
+}
+
+int atlas_text_width(const AtlasFont *font, const char *text) {
+  int width = 0;
+  for (const char *c = text; *c; c++) {
+    if (*c >= ATLAS_FIRST_CHAR && *c <= ATLAS_LAST_CHAR)
+      width += font->glyphs[*c - ATLAS_FIRST_CHAR].advance;
+  }
+  return width;
 }
 
-void draw_cached_text(CachedText *cache, float x, float y, bool center,
-                      float alpha) {
-  if (cache->texture == 0)
+void draw_atlas_text(const GlyphAtlas *atlas, const AtlasFont *font,
+                     const char *text, float x, float y, bool center,
+                     SDL_Color color, float alpha) {
+  static GLfloat verts[ATLAS_MAX_TEXT * 4 * 4]; // x, y, u, v
+  if (atlas->texture == 0 || !font->loaded)
     return;
-  glEnable(GL_TEXTURE_2D);
-  glBindTexture(GL_TEXTURE_2D, cache->texture);
-  glColor4f(1.0f, 1.0f, 1.0f, alpha);
 
   float dx = x;
   float dy = y;
   if (center) {
-    dx -= cache->w / 2.0f;
-    dy -= cache->h / 2.0f;
+    dx -= atlas_text_width(font, text) / 2.0f;
+    dy -= font->height / 2.0f;
   }
+  // whole pixels keep the glyphs crisp under linear filtering
+  dx = floorf(dx + 0.5f);
+  dy = floorf(dy + 0.5f);
 
-  glBegin(GL_QUADS);
-  glTexCoord2f(0, 0);
-  glVertex2f(dx, dy);
-  glTexCoord2f(1, 0);
-  glVertex2f(dx + cache->w, dy);
-  glTexCoord2f(1, 1);
-  glVertex2f(dx + cache->w, dy + cache->h);
-  glTexCoord2f(0, 1);
-  glVertex2f(dx, dy + cache->h);
-  glEnd();
-  glDisable(GL_TEXTURE_2D);
-}
-void drawRing(float x, float y, float outerR, float innerR, float start_angle,
-              float end_angle, float r, float g, float b) {
-
-  glColor3f(r, g, b);
-  glBegin(GL_TRIANGLE_STRIP);
-
-  int segments = 100;
-  for (int i = 0; i <= segments; i++) {
-    float angle =
-        start_angle + (end_angle - start_angle) * (i / (float)segments);
-    float rad = (angle - 90.0f) * M_PI / 180.0f;
-
-    glVertex2f(x + cos(rad) * outerR, y + sin(rad) * outerR);
-    glVertex2f(x + cos(rad) * innerR, y + sin(rad) * innerR);
+  int n = 0;
+  for (const char *c = text; *c && n < ATLAS_MAX_TEXT; c++) {
+    if (*c < ATLAS_FIRST_CHAR || *c > ATLAS_LAST_CHAR)
+      continue;
+    const AtlasGlyph *g = &font->glyphs[*c - ATLAS_FIRST_CHAR];
+    if (g->w > 0) {
+      GLfloat quad[16] = {dx,        dy,        g->u0, g->v0,
+                          dx + g->w, dy,        g->u1, g->v0,
+                          dx + g->w, dy + g->h, g->u1, g->v1,
+                          dx,        dy + g->h, g->u0, g->v1};
+      memcpy(&verts[n * 16], quad, sizeof(quad));
+      n++;
+    }
+    dx += g->advance;
   }
+  if (n == 0)
+    return;
 
-  glEnd();
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, atlas->texture);
+  glColor4f(color.r / 255.0f, color.g / 255.0f, color.b / 255.0f,
+            color.a / 255.0f * alpha);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), verts);
+  glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), verts + 2);
+  glDrawArrays(GL_QUADS, 0, n * 4);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glDisable(GL_TEXTURE_2D);
 }
 
 void rendertexty(TTF_Font *font, const char *text, SDL_Color color, float x,
@@ -274,22 +716,219 @@ SDL_HitTestResult drag_hit_test(SDL_Window *window, const SDL_Point *area,
   return SDL_HITTEST_DRAGGABLE;
 }
 
-void save_config(const Config *cfg) {
-  FILE *f = fopen(CONFIG_PATH, "w");
+#define CONFIG_QUIET_MS 500 // coalesce config saves until input settles
+#define JOURNAL_SYNC_MS 250 // one journal fsync covers this much appending
+
+// Config writes go through a background thread: save_config() only records
+// the latest Config, the writer flushes it once changes have been quiet for
+// CONFIG_QUIET_MS, skips it if the text matches what's already on disk, and
+// replaces the file atomically via rename().
+//
+// The same thread does the session journal's slow work: the group fsync
+// JOURNAL_SYNC_MS after the first unsynced record, and writing the streak.txt
+// snapshot when the journal gets compacted.
+typedef struct {
+  SDL_Thread *thread;
+  SDL_mutex *lock;    // guards everything below
+  SDL_mutex *io_lock; // serializes the actual file writes
+  SDL_cond *cond;
+  Config pending;
+  bool has_pending;
+  uint32_t last_request;
+  char persisted[512]; // config text last written or read
+  int journal_fd;
+  bool journal_dirty;     // records appended but not fsynced yet
+  uint32_t journal_since; // when the oldest of them was appended
+  Streak *snapshot;       // streak copy to fold the journal into, owned here
+  bool read_only;         // --bench-render: never write pomo.cfg
+  bool quit;
+} ConfigWriter;
+
+ConfigWriter config_writer;
+
+// defined with the journal below
+void fold_journal_copy(Streak *snap);
+
+void format_config(const Config *cfg, char *buf, size_t len) {
+  snprintf(buf, len,
+           "work_time=%d\n"
+           "break_time=%d\n"
+           "long_break_time=%d\n"
+           "sessions_until_long=%d\n"
+           "sound=%d\n"
+           "auto_start=%d\n"
+           "opacity=%d\n"
+           "volume=%d\n"
+           "focus_threshold=%d\n"
+           "audio_cache_mb=%d\n"
+           "work_chime=%d\n"
+           "break_chime=%d\n"
+           "long_break_chime=%d\n"
+           "suspend_policy=%d\n"
+           "x=%d\n"
+           "y=%d\n",
+           cfg->work_min, cfg->break_min, cfg->long_break_min,
+           cfg->sessions_until_long, cfg->sound_on ? 1 : 0,
+           cfg->auto_start ? 1 : 0, cfg->opacity, cfg->volume,
+           cfg->focus_threshold, cfg->audio_cache_mb, cfg->work_chime,
+           cfg->break_chime, cfg->long_break_chime, cfg->suspend_policy,
+           cfg->x, cfg->y);
+}
+
+// Writes pomo.cfg.tmp and renames it over pomo.cfg, so a crash leaves either
+// the old or the new file, never a truncated one.
+bool write_config_file(const char *text) {
+  const char *tmp = CONFIG_PATH ".tmp";
+  FILE *f = fopen(tmp, "w");
   if (!f)
+    return false;
+  bool ok = fputs(text, f) >= 0 && fflush(f) == 0 && fsync(fileno(f)) == 0;
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(tmp, CONFIG_PATH) != 0) {
+    remove(tmp);
+    return false;
+  }
+  return true;
+}
+
+// Writes cfg now unless it matches what's on disk. Called from the writer
+// thread, from flush_config() and before the writer is running.
+void write_config_if_changed(const Config *cfg) {
+  ConfigWriter *cw = &config_writer;
+  char text[512];
+  format_config(cfg, text, sizeof(text));
+
+  if (cw->io_lock)
+    SDL_LockMutex(cw->io_lock);
+  if (cw->lock)
+    SDL_LockMutex(cw->lock);
+  bool changed = strcmp(text, cw->persisted) != 0;
+  if (cw->lock)
+    SDL_UnlockMutex(cw->lock);
+
+  if (changed && write_config_file(text)) {
+    if (cw->lock)
+      SDL_LockMutex(cw->lock);
+    strcpy(cw->persisted, text);
+    if (cw->lock)
+      SDL_UnlockMutex(cw->lock);
+  }
+  if (cw->io_lock)
+    SDL_UnlockMutex(cw->io_lock);
+}
+
+int config_writer_thread(void *data) {
+  ConfigWriter *cw = data;
+  SDL_LockMutex(cw->lock);
+  while (!cw->quit) {
+    uint32_t now = SDL_GetTicks();
+    if (cw->journal_dirty && now - cw->journal_since >= JOURNAL_SYNC_MS) {
+      cw->journal_dirty = false;
+      SDL_UnlockMutex(cw->lock);
+      if (fsync(cw->journal_fd) != 0)
+        fprintf(stderr, "Failed to sync %s\n", JOURNAL_PATH);
+      SDL_LockMutex(cw->lock);
+      continue;
+    }
+    if (cw->snapshot) {
+      Streak *snap = cw->snapshot;
+      cw->snapshot = NULL;
+      SDL_UnlockMutex(cw->lock);
+      fold_journal_copy(snap);
+      SDL_LockMutex(cw->lock);
+      continue;
+    }
+    if (cw->has_pending && now - cw->last_request >= CONFIG_QUIET_MS) {
+      Config cfg = cw->pending;
+      cw->has_pending = false;
+      SDL_UnlockMutex(cw->lock);
+      write_config_if_changed(&cfg);
+      SDL_LockMutex(cw->lock);
+      continue;
+    }
+    // sleep until the nearest deadline, or until something new comes in
+    int wait = -1;
+    if (cw->journal_dirty)
+      wait = JOURNAL_SYNC_MS - (now - cw->journal_since);
+    if (cw->has_pending) {
+      int quiet = CONFIG_QUIET_MS - (now - cw->last_request);
+      if (wait < 0 || quiet < wait)
+        wait = quiet;
+    }
+    if (wait < 0)
+      SDL_CondWait(cw->cond, cw->lock);
+    else
+      SDL_CondWaitTimeout(cw->cond, cw->lock, wait);
+  }
+  SDL_UnlockMutex(cw->lock);
+  return 0;
+}
+
+void start_config_writer(void) {
+  ConfigWriter *cw = &config_writer;
+  if (cw->thread)
     return;
-  fprintf(f, "work_time=%d\n", cfg->work_min);
-  fprintf(f, "break_time=%d\n", cfg->break_min);
-  fprintf(f, "long_break_time=%d\n", cfg->long_break_min);
-  fprintf(f, "sessions_until_long=%d\n", cfg->sessions_until_long);
-  fprintf(f, "sound=%d\n", cfg->sound_on ? 1 : 0);
-  fprintf(f, "auto_start=%d\n", cfg->auto_start ? 1 : 0);
-  fprintf(f, "opacity=%d\n", cfg->opacity);
-  fprintf(f, "volume=%d\n", cfg->volume);
-  fprintf(f, "focus_threshold=%d\n", cfg->focus_threshold);
-  fprintf(f, "x=%d\n", cfg->x);
-  fprintf(f, "y=%d\n", cfg->y);
-  fclose(f);
+  if (!cw->lock) { // the bench starts and stops it more than once
+    cw->lock = SDL_CreateMutex();
+    cw->io_lock = SDL_CreateMutex();
+    cw->cond = SDL_CreateCond();
+  }
+  cw->quit = false;
+  if (cw->lock && cw->io_lock && cw->cond)
+    cw->thread = SDL_CreateThread(config_writer_thread, "config", cw);
+  if (!cw->thread)
+    fprintf(stderr, "Config writer thread failed, saving inline: %s\n",
+            SDL_GetError());
+}
+
+// Writes out a pending save right away, on the calling thread.
+void flush_config(void) {
+  ConfigWriter *cw = &config_writer;
+  if (!cw->lock)
+    return;
+  SDL_LockMutex(cw->lock);
+  bool pending = cw->has_pending;
+  Config cfg = cw->pending;
+  cw->has_pending = false;
+  SDL_UnlockMutex(cw->lock);
+  if (pending)
+    write_config_if_changed(&cfg);
+}
+
+void stop_config_writer(void) {
+  ConfigWriter *cw = &config_writer;
+  if (cw->thread) {
+    SDL_LockMutex(cw->lock);
+    cw->quit = true;
+    SDL_CondSignal(cw->cond);
+    SDL_UnlockMutex(cw->lock);
+    SDL_WaitThread(cw->thread, NULL);
+    cw->thread = NULL;
+    cw->journal_dirty = false; // close_journal() syncs
+  }
+  if (cw->snapshot) {
+    fold_journal_copy(cw->snapshot);
+    cw->snapshot = NULL;
+  }
+  flush_config();
+}
+
+// Cheap enough to call on every change: the write happens later, off the
+// UI thread, and only if the result differs from the file.
+void save_config(const Config *cfg) {
+  ConfigWriter *cw = &config_writer;
+  if (cw->read_only)
+    return;
+  if (!cw->thread) {
+    write_config_if_changed(cfg);
+    return;
+  }
+  SDL_LockMutex(cw->lock);
+  cw->pending = *cfg;
+  cw->has_pending = true;
+  cw->last_request = SDL_GetTicks();
+  SDL_CondSignal(cw->cond);
+  SDL_UnlockMutex(cw->lock);
 }
 
 void load_config(Config *cfg) {
@@ -302,6 +941,11 @@ void load_config(Config *cfg) {
   cfg->opacity = 100;
   cfg->volume = 128;
   cfg->focus_threshold = 60;
+  cfg->audio_cache_mb = 32; // ~87 s at 48 kHz float stereo, both heads
+  cfg->work_chime = 96;
+  cfg->break_chime = 96;
+  cfg->long_break_chime = 96;
+  cfg->suspend_policy = 0; // pause
   cfg->x = SDL_WINDOWPOS_CENTERED;
   cfg->y = SDL_WINDOWPOS_CENTERED;
 
@@ -330,603 +974,4036 @@ void load_config(Config *cfg) {
       continue;
     if (sscanf(line, "focus_threshold=%d", &cfg->focus_threshold) == 1)
       continue;
+    if (sscanf(line, "audio_cache_mb=%d", &cfg->audio_cache_mb) == 1)
+      continue;
+    if (sscanf(line, "work_chime=%d", &cfg->work_chime) == 1)
+      continue;
+    if (sscanf(line, "break_chime=%d", &cfg->break_chime) == 1)
+      continue;
+    if (sscanf(line, "long_break_chime=%d", &cfg->long_break_chime) == 1)
+      continue;
+    if (sscanf(line, "suspend_policy=%d", &cfg->suspend_policy) == 1)
+      continue;
     if (sscanf(line, "x=%d", &cfg->x) == 1)
       continue;
     if (sscanf(line, "y=%d", &cfg->y) == 1)
       continue;
   }
   fclose(f);
+  // the cache budget becomes a byte count in a Uint32
+  if (cfg->audio_cache_mb < 0)
+    cfg->audio_cache_mb = 0;
+  if (cfg->audio_cache_mb > AUDIO_CACHE_MAX_MB)
+    cfg->audio_cache_mb = AUDIO_CACHE_MAX_MB;
+
+  // what's on disk now, so saving the same values again is a no-op
+  ConfigWriter *cw = &config_writer;
+  if (cw->lock)
+    SDL_LockMutex(cw->lock);
+  format_config(cfg, cw->persisted, sizeof(cw->persisted));
+  if (cw->lock)
+    SDL_UnlockMutex(cw->lock);
 }
 
-void save_streak(const Streak *s) {
-  FILE *f = fopen(STREAK_PATH, "w");
-  if (!f)
-    return;
-  fprintf(f, "last_date=%s\n", s->last_date);
-  fprintf(f, "daily_sessions=%d\n", s->daily_sessions);
-  fprintf(f, "consecutive_days=%d\n", s->consecutive_days);
-  for (int i = 0; i < s->history_count; i++) {
-    fprintf(f, "h:%s=%d\n", s->history[i].date, s->history[i].sessions);
-  }
-  fclose(f);
+// A save that hasn't reached the file yet is newer than what's in it.
+bool config_save_pending(void) {
+  ConfigWriter *cw = &config_writer;
+  if (!cw->lock)
+    return false;
+  SDL_LockMutex(cw->lock);
+  bool pending = cw->has_pending;
+  SDL_UnlockMutex(cw->lock);
+  return pending;
 }
 
-void load_streak(Streak *s) {
-  strcpy(s->last_date, "0000-00-00");
-  s->daily_sessions = 0;
-  s->consecutive_days = 0;
-  s->history_count = 0;
-
-  FILE *f = fopen(STREAK_PATH, "r");
-  if (!f)
-    return;
-  char line[128];
-  while (fgets(line, sizeof(line), f)) {
-    if (sscanf(line, "last_date=%10s", s->last_date) == 1)
-      continue;
-    if (sscanf(line, "daily_sessions=%d", &s->daily_sessions) == 1)
-      continue;
-    if (sscanf(line, "consecutive_days=%d", &s->consecutive_days) == 1)
-      continue;
-    char d[11];
-    int sess;
-    if (sscanf(line, "h:%10[^=]=%d", d, &sess) == 2) {
-      if (s->history_count < MAX_HISTORY) {
-        strcpy(s->history[s->history_count].date, d);
-        s->history[s->history_count].sessions = sess;
-        s->history_count++;
-      }
-    }
+// True if pomo.cfg holds exactly the text the writer last wrote or read,
+// i.e. the change was our own tmp+rename, or an edit that changed nothing.
+// Holding io_lock means we never see a file the writer hasn't recorded yet.
+bool config_matches_persisted(void) {
+  ConfigWriter *cw = &config_writer;
+  char text[512];
+  if (cw->io_lock)
+    SDL_LockMutex(cw->io_lock);
+  FILE *f = fopen(CONFIG_PATH, "r");
+  bool same = false;
+  if (f) {
+    size_t len = fread(text, 1, sizeof(text) - 1, f);
+    text[len] = '\0';
+    fclose(f);
+    if (cw->lock)
+      SDL_LockMutex(cw->lock);
+    same = strcmp(text, cw->persisted) == 0;
+    if (cw->lock)
+      SDL_UnlockMutex(cw->lock);
   }
-  fclose(f);
+  if (cw->io_lock)
+    SDL_UnlockMutex(cw->io_lock);
+  return same;
 }
 
-void update_streak(Streak *s) {
-  time_t now = time(NULL);
-  struct tm *t = localtime(&now);
-  char today[11];
-  strftime(today, sizeof(today), "%Y-%m-%d", t);
+// Watches pomo.cfg for changes made outside the app (Linux inotify). The
+// watcher thread only posts config_changed_event; the reload itself happens
+// on the main thread. Elsewhere we fall back to reloading on focus gain.
+typedef struct {
+  SDL_Thread *thread;
+  int fd;
+  int wake[2]; // written to on shutdown to break out of poll()
+  SDL_atomic_t posted; // an event is queued and not handled yet
+} ConfigWatcher;
+
+ConfigWatcher config_watcher = {NULL, -1, {-1, -1}};
+Uint32 config_changed_event = (Uint32)-1;
+
+#ifdef __linux__
+int config_watcher_thread(void *data) {
+  ConfigWatcher *cw = data;
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct pollfd fds[2] = {{cw->fd, POLLIN, 0}, {cw->wake[0], POLLIN, 0}};
+
+  for (;;) {
+    if (poll(fds, 2, -1) < 0)
+      continue;
+    if (fds[1].revents)
+      break;
+    ssize_t len = read(cw->fd, buf, sizeof(buf));
+    if (len <= 0)
+      continue;
 
-  if (strcmp(s->last_date, today) == 0) {
-    s->daily_sessions++;
-    // Update history entry for today
-    bool found = false;
-    for (int i = 0; i < s->history_count; i++) {
-      if (strcmp(s->history[i].date, today) == 0) {
-        s->history[i].sessions = s->daily_sessions;
-        found = true;
-        break;
-      }
-    }
-    if (!found && s->history_count < MAX_HISTORY) {
-      strcpy(s->history[s->history_count].date, today);
-      s->history[s->history_count].sessions = s->daily_sessions;
-      s->history_count++;
-    }
-  } else {
-    // Check if it was yesterday
-    struct tm last_tm = {0};
-    int y, m, d;
-    if (sscanf(s->last_date, "%d-%d-%d", &y, &m, &d) == 3) {
-      last_tm.tm_year = y - 1900;
-      last_tm.tm_mon = m - 1;
-      last_tm.tm_mday = d;
-      last_tm.tm_isdst = -1;
-      time_t last_t = mktime(&last_tm);
-
-      double diff = difftime(now, last_t);
-      if (diff > 0 && diff <= 86400 * 1.5) { // Roughly within a day
-        s->consecutive_days++;
-      } else {
-        s->consecutive_days = 1;
-      }
-    } else {
-      s->consecutive_days = 1;
+    bool changed = false;
+    for (char *p = buf; p < buf + len;) {
+      struct inotify_event *ev = (struct inotify_event *)p;
+      if (ev->len && strcmp(ev->name, CONFIG_PATH) == 0)
+        changed = true;
+      p += sizeof(struct inotify_event) + ev->len;
     }
-    s->daily_sessions = 1;
-    strcpy(s->last_date, today);
-
-    // Add new history entry
-    if (s->history_count < MAX_HISTORY) {
-      strcpy(s->history[s->history_count].date, today);
-      s->history[s->history_count].sessions = 1;
-      s->history_count++;
-    } else {
-      // Shift history to make room
-      for (int i = 0; i < MAX_HISTORY - 1; i++) {
-        s->history[i] = s->history[i + 1];
-      }
-      strcpy(s->history[MAX_HISTORY - 1].date, today);
-      s->history[MAX_HISTORY - 1].sessions = 1;
+    // editors touch the file several times per save; one queued reload
+    // covers them all. our own saves land here too, skip those.
+    if (changed && !config_matches_persisted() &&
+        SDL_AtomicCAS(&cw->posted, 0, 1)) {
+      SDL_Event e = {0};
+      e.type = config_changed_event;
+      SDL_PushEvent(&e);
     }
   }
-  save_streak(s);
+  return 0;
 }
+#endif
 
-void reset_timer(Timer *timer, SDL_Window *window) {
-  timer->state = w;
-  timer->sec_remain = timer->config.work_min * 60.0;
-  timer->paused = false;
-  timer->elapsed_work = 0;
-  timer->elapsed_break = 0;
-  timer->pause_duration = 0;
-  if (timer->is_shaking) {
-    SDL_SetWindowPosition(window, timer->base_x, timer->base_y);
-    timer->is_shaking = false;
+bool start_config_watcher(void) {
+#ifdef __linux__
+  ConfigWatcher *cw = &config_watcher;
+  config_changed_event = SDL_RegisterEvents(1);
+  if (config_changed_event == (Uint32)-1)
+    return false;
+  cw->fd = inotify_init1(IN_CLOEXEC);
+  if (cw->fd < 0)
+    return false;
+  // CONFIG_PATH lives in the working directory. Watch the directory rather
+  // than the file: atomic saves (ours, vim, ...) replace the inode.
+  if (inotify_add_watch(cw->fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+      pipe(cw->wake) != 0) {
+    close(cw->fd);
+    cw->fd = -1;
+    return false;
   }
-  if (timer->music && timer->config.sound_on) {
-    Mix_SetMusicPosition(0);
-    Mix_ResumeMusic();
+  cw->thread = SDL_CreateThread(config_watcher_thread, "cfgwatch", cw);
+  if (!cw->thread) {
+    close(cw->fd);
+    close(cw->wake[0]);
+    close(cw->wake[1]);
+    cw->fd = cw->wake[0] = cw->wake[1] = -1;
+    return false;
   }
+  return true;
+#else
+  return false;
+#endif
 }
 
-void open_settings_window(Timer *timer, TTF_Font *font) {
-  if (timer->settings_win)
+void stop_config_watcher(void) {
+#ifdef __linux__
+  ConfigWatcher *cw = &config_watcher;
+  if (!cw->thread)
     return;
-
-  timer->settings_win =
-      SDL_CreateWindow("Configuration", SDL_WINDOWPOS_CENTERED,
-                       SDL_WINDOWPOS_CENTERED, 320, 420, SDL_WINDOW_SHOWN);
-  timer->settings_ren =
-      SDL_CreateRenderer(timer->settings_win, -1, SDL_RENDERER_ACCELERATED);
-  timer->selected_setting = 0;
+  if (write(cw->wake[1], "x", 1) < 0)
+    perror("config watcher");
+  SDL_WaitThread(cw->thread, NULL);
+  cw->thread = NULL;
+  close(cw->fd);
+  close(cw->wake[0]);
+  close(cw->wake[1]);
+  cw->fd = cw->wake[0] = cw->wake[1] = -1;
+#endif
 }
 
-void render_settings(Timer *timer, TTF_Font *font) {
-  if (!timer->settings_win)
-    return;
-
-  SDL_SetRenderDrawColor(timer->settings_ren, 20, 22, 28, 255);
-  SDL_RenderClear(timer->settings_ren);
+// Idle detection. Each IdleSource reports seconds since the last user
+// input anywhere on the system; the first one that opens is sampled on a
+// worker thread, which posts idle_changed_event (code 1 = away, 0 = back)
+// only when the away state flips. The main loop never asks itself.
+typedef struct {
+  const char *name;
+  bool (*open)(void);
+  double (*idle_seconds)(void); // < 0 if the source stopped working
+  void (*close)(void);
+} IdleSource;
 
-  SDL_Color white = {255, 255, 255, 255};
-  SDL_Color gray = {139, 148, 158, 255};
-  SDL_Color highlight = {56, 139, 253, 40}; // Blue-ish highlight
-  char buf[256];
+#ifdef __APPLE__
+bool quartz_idle_open(void) { return true; }
 
-  // Title (fixed at top)
-  SDL_Surface *title_s = TTF_RenderText_Blended(font, "Configuration", white);
-  if (title_s) {
-    SDL_Texture *title_t =
-        SDL_CreateTextureFromSurface(timer->settings_ren, title_s);
-    SDL_Rect title_r = {20, 10, title_s->w, title_s->h};
-    SDL_RenderCopy(timer->settings_ren, title_t, NULL, &title_r);
-    SDL_FreeSurface(title_s);
-    SDL_DestroyTexture(title_t);
-  }
+double quartz_idle_seconds(void) {
+  return CGEventSourceSecondsSinceLastEventType(
+      kCGEventSourceStateCombinedSessionState, kCGAnyInputEventType);
+}
 
-  const char *settings_names[] = {"Work Duration (min)",
-                                  "Break Duration (min)",
-                                  "Long Break Duration (min)",
-                                  "Sessions until Long Break",
-                                  "Sound Enabled",
-                                  "Auto-start Next Session",
-                                  "Opacity (Unused in C)",
-                                  "Volume (0-128)",
-                                  "Focus Idle Thr. (s)"};
+void quartz_idle_close(void) {}
+#endif
 
-  int num_settings = 9;
-  int start_y = 50;
-  int row_h = 35; // Match Cocoa row height
-  int win_h = 420;
-  int win_w = 320;
-  int max_visible_h = win_h - start_y;
-  int total_h = num_settings * row_h;
+#ifdef __linux__
+// X11 through the MIT-SCREEN-SAVER extension. Xlib and libXss are loaded at
+// runtime so Wayland-only and headless machines don't need them installed.
+typedef struct {
+  unsigned long window;
+  int state, kind;
+  unsigned long til_or_since, idle, event_mask;
+} XssInfo;
+
+struct {
+  void *xlib, *xss, *display;
+  XssInfo *info;
+  void *(*open_display)(const char *);
+  int (*close_display)(void *);
+  unsigned long (*root_window)(void *);
+  int (*query_extension)(void *, int *, int *);
+  XssInfo *(*alloc_info)(void);
+  int (*query_info)(void *, unsigned long, XssInfo *);
+  int (*free)(void *);
+} x11_idle;
+
+void x11_idle_close(void) {
+  if (x11_idle.info)
+    x11_idle.free(x11_idle.info);
+  if (x11_idle.display)
+    x11_idle.close_display(x11_idle.display);
+  if (x11_idle.xss)
+    dlclose(x11_idle.xss);
+  if (x11_idle.xlib)
+    dlclose(x11_idle.xlib);
+  memset(&x11_idle, 0, sizeof(x11_idle));
+}
 
-  // Clamp scroll
-  int max_scroll = fmax(0, total_h - max_visible_h + 20); // +20 padding
-  timer->settings_scroll_y =
-      fmin(max_scroll, fmax(0, timer->settings_scroll_y));
+bool x11_idle_open(void) {
+  if (!getenv("DISPLAY"))
+    return false;
+  x11_idle.xlib = dlopen("libX11.so.6", RTLD_NOW);
+  x11_idle.xss = dlopen("libXss.so.1", RTLD_NOW);
+  if (!x11_idle.xlib || !x11_idle.xss) {
+    x11_idle_close();
+    return false;
+  }
+  *(void **)&x11_idle.open_display = dlsym(x11_idle.xlib, "XOpenDisplay");
+  *(void **)&x11_idle.close_display = dlsym(x11_idle.xlib, "XCloseDisplay");
+  *(void **)&x11_idle.root_window = dlsym(x11_idle.xlib, "XDefaultRootWindow");
+  *(void **)&x11_idle.free = dlsym(x11_idle.xlib, "XFree");
+  *(void **)&x11_idle.query_extension =
+      dlsym(x11_idle.xss, "XScreenSaverQueryExtension");
+  *(void **)&x11_idle.alloc_info = dlsym(x11_idle.xss, "XScreenSaverAllocInfo");
+  *(void **)&x11_idle.query_info = dlsym(x11_idle.xss, "XScreenSaverQueryInfo");
+  if (!x11_idle.open_display || !x11_idle.close_display ||
+      !x11_idle.root_window || !x11_idle.free || !x11_idle.query_extension ||
+      !x11_idle.alloc_info || !x11_idle.query_info) {
+    x11_idle_close();
+    return false;
+  }
+  // our own connection, only ever used from the idle thread
+  x11_idle.display = x11_idle.open_display(NULL);
+  int event_base, error_base;
+  if (!x11_idle.display ||
+      !x11_idle.query_extension(x11_idle.display, &event_base, &error_base) ||
+      !(x11_idle.info = x11_idle.alloc_info())) {
+    x11_idle_close();
+    return false;
+  }
+  return true;
+}
 
-  SDL_Rect clip_rect = {0, start_y, win_w, max_visible_h};
-  SDL_RenderSetClipRect(timer->settings_ren, &clip_rect);
+double x11_idle_seconds(void) {
+  if (!x11_idle.query_info(x11_idle.display,
+                           x11_idle.root_window(x11_idle.display),
+                           x11_idle.info))
+    return -1;
+  return x11_idle.info->idle / 1000.0;
+}
 
-  for (int i = 0; i < num_settings; i++) {
-    int y = start_y + i * row_h - timer->settings_scroll_y;
+// evdev: any readable event on /dev/input/event* counts as input. Works on
+// Wayland and without a display, but needs read access to the devices
+// (usually the input group).
+#define MAX_INPUT_DEVICES 32
+
+struct {
+  int fds[MAX_INPUT_DEVICES];
+  int count;
+  double last_input;
+} evdev_idle;
+
+void evdev_idle_close(void) {
+  for (int i = 0; i < evdev_idle.count; i++)
+    close(evdev_idle.fds[i]);
+  evdev_idle.count = 0;
+}
 
-    // Cull invisible items
-    if (y + row_h < start_y || y > win_h)
+bool evdev_idle_open(void) {
+  DIR *dir = opendir("/dev/input");
+  if (!dir)
+    return false;
+  struct dirent *ent;
+  while ((ent = readdir(dir)) && evdev_idle.count < MAX_INPUT_DEVICES) {
+    if (strncmp(ent->d_name, "event", 5) != 0)
       continue;
+    char path[300];
+    snprintf(path, sizeof(path), "/dev/input/%s", ent->d_name);
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd >= 0)
+      evdev_idle.fds[evdev_idle.count++] = fd;
+  }
+  closedir(dir);
+  evdev_idle.last_input = SDL_GetTicks() / 1000.0;
+  return evdev_idle.count > 0;
+}
+
+// Drains whatever queued up since the last sample, so the answer is only
+// as fine as the sampling interval. That's plenty for a threshold check.
+double evdev_idle_seconds(void) {
+  double now = SDL_GetTicks() / 1000.0;
+  struct input_event events[64];
+  for (int i = 0; i < evdev_idle.count; i++) {
+    while (read(evdev_idle.fds[i], events, sizeof(events)) > 0)
+      evdev_idle.last_input = now;
+  }
+  return now - evdev_idle.last_input;
+}
+#endif
+
+const IdleSource idle_sources[] = {
+#ifdef __APPLE__
+    {"quartz", quartz_idle_open, quartz_idle_seconds, quartz_idle_close},
+#endif
+#ifdef __linux__
+    {"x11", x11_idle_open, x11_idle_seconds, x11_idle_close},
+    {"evdev", evdev_idle_open, evdev_idle_seconds, evdev_idle_close},
+#endif
+    {NULL},
+};
+
+typedef struct {
+  SDL_Thread *thread;
+  SDL_mutex *lock;
+  SDL_cond *cond; // signalled on shutdown and on a new threshold
+  bool quit;
+  const IdleSource *source;
+  SDL_atomic_t threshold; // focus_threshold, seconds
+} IdleMonitor;
+
+IdleMonitor idle_monitor;
+Uint32 idle_changed_event = (Uint32)-1;
+
+int idle_monitor_thread(void *data) {
+  IdleMonitor *im = data;
+  bool away = false;
+  SDL_LockMutex(im->lock);
+  while (!im->quit) {
+    SDL_UnlockMutex(im->lock);
+    int threshold = SDL_AtomicGet(&im->threshold);
+    double idle = im->source->idle_seconds();
+    if (idle >= 0 && (idle >= threshold) != away) {
+      away = !away;
+      SDL_Event e = {0};
+      e.type = idle_changed_event;
+      e.user.code = away;
+      SDL_PushEvent(&e);
+    }
+    // Nothing can change before the threshold is reached, so sleep until
+    // then. Once away, check back every couple of seconds.
+    double wait = away ? 2.0 : threshold - (idle >= 0 ? idle : 0);
+    if (wait < 1.0)
+      wait = 1.0;
+    SDL_LockMutex(im->lock);
+    // a new threshold means a new plan, sample again right away
+    if (!im->quit && SDL_AtomicGet(&im->threshold) == threshold)
+      SDL_CondWaitTimeout(im->cond, im->lock, (Uint32)(wait * 1000));
+  }
+  SDL_UnlockMutex(im->lock);
+  return 0;
+}
+
+bool start_idle_monitor(int threshold) {
+  IdleMonitor *im = &idle_monitor;
+  for (const IdleSource *src = idle_sources; src->name; src++) {
+    if (src->open()) {
+      im->source = src;
+      break;
+    }
+  }
+  if (!im->source) {
+    fprintf(stderr, "No idle source available, focus detection is off\n");
+    return false;
+  }
+  idle_changed_event = SDL_RegisterEvents(1);
+  im->lock = SDL_CreateMutex();
+  im->cond = SDL_CreateCond();
+  SDL_AtomicSet(&im->threshold, threshold);
+  if (idle_changed_event == (Uint32)-1 || !im->lock || !im->cond ||
+      !(im->thread = SDL_CreateThread(idle_monitor_thread, "idle", im))) {
+    fprintf(stderr, "Failed to start idle monitor: %s\n", SDL_GetError());
+    im->source->close();
+    im->source = NULL;
+    return false;
+  }
+  verbose_log("Idle detection: %s\n", im->source->name);
+  return true;
+}
+
+// Wakes the thread if the threshold changed, so a lower one doesn't wait
+// out a sleep planned for the old one.
+void set_idle_threshold(int threshold) {
+  IdleMonitor *im = &idle_monitor;
+  if (!im->thread || SDL_AtomicGet(&im->threshold) == threshold)
+    return;
+  SDL_LockMutex(im->lock);
+  SDL_AtomicSet(&im->threshold, threshold);
+  SDL_CondSignal(im->cond);
+  SDL_UnlockMutex(im->lock);
+}
+
+void stop_idle_monitor(void) {
+  IdleMonitor *im = &idle_monitor;
+  if (im->thread) {
+    SDL_LockMutex(im->lock);
+    im->quit = true;
+    SDL_CondSignal(im->cond);
+    SDL_UnlockMutex(im->lock);
+    SDL_WaitThread(im->thread, NULL);
+    im->thread = NULL;
+    im->source->close();
+  }
+  if (im->cond)
+    SDL_DestroyCond(im->cond);
+  if (im->lock)
+    SDL_DestroyMutex(im->lock);
+  im->cond = NULL;
+  im->lock = NULL;
+}
+
+// --print-idle: what every idle source reports right now, for checking a
+// backend by hand (e.g. make idle-xvfb).
+int print_idle_sources(void) {
+  int found = 0;
+  for (const IdleSource *src = idle_sources; src->name; src++) {
+    if (!src->open()) {
+      printf("%s: unavailable\n", src->name);
+      continue;
+    }
+    double idle = src->idle_seconds();
+    if (idle < 0)
+      printf("%s: query failed\n", src->name);
+    else
+      printf("%s: idle %.1f s\n", src->name, idle);
+    src->close();
+    found++;
+  }
+  return found ? 0 : 1;
+}
+
+// Day numbers are days since 1970-01-01 in the proleptic Gregorian calendar
+// (H. Hinnant's civil date algorithms), so date math needs no localtime.
+int days_from_civil(int y, int m, int d) {
+  y -= m <= 2;
+  int era = (y >= 0 ? y : y - 399) / 400;
+  int yoe = y - era * 400;
+  int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+void civil_from_days(int z, int *y, int *m, int *d) {
+  z += 719468;
+  int era = (z >= 0 ? z : z - 146096) / 146097;
+  int doe = z - era * 146097;
+  int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int mp = (5 * doy + 2) / 153;
+  *d = doy - (153 * mp + 2) / 5 + 1;
+  *m = mp + (mp < 10 ? 3 : -9);
+  *y = yoe + era * 400 + (*m <= 2);
+}
+
+// The timer core only reads the time through mono_now() and wall_now(), so
+// --simulate can put them on a virtual clock and fast-forward through months.
+typedef struct {
+  bool on;
+  double mono; // what mono_now() returns
+  time_t wall0; // wall_now() at mono 0
+} VirtualClock;
+
+VirtualClock virtual_clock;
+
+time_t wall_now(void) {
+  if (virtual_clock.on)
+    return virtual_clock.wall0 + (time_t)virtual_clock.mono;
+  return time(NULL);
+}
+
+// All local-date handling goes through these three: a day number is the
+// local calendar day, and streak.txt stores it as YYYY-MM-DD.
+int local_day(time_t t) {
+  struct tm *tm = localtime(&t);
+  return days_from_civil(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
+}
+
+bool parse_day(const char *text, int *day) {
+  int y, m, d;
+  if (sscanf(text, "%d-%d-%d", &y, &m, &d) != 3 || m < 1 || m > 12 || d < 1 ||
+      d > 31)
+    return false;
+  *day = days_from_civil(y, m, d);
+  return true;
+}
+
+void format_day(int day, char buf[11]) {
+  if (day == NO_DAY) {
+    strcpy(buf, "0000-00-00");
+    return;
+  }
+  int y, m, d;
+  civil_from_days(day, &y, &m, &d);
+  snprintf(buf, 11, "%04d-%02d-%02d", y, m, d);
+}
+
+int floor_div(int a, int b) {
+  return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+int history_get(const History *h, int day) {
+  int c = floor_div(day, HISTORY_CHUNK_DAYS) - h->base_chunk;
+  if (c < 0 || c >= h->num_chunks || !h->chunks[c])
+    return 0;
+  return h->chunks[c][day - (h->base_chunk + c) * HISTORY_CHUNK_DAYS];
+}
+
+void history_set(History *h, int day, int sessions) {
+  int chunk = floor_div(day, HISTORY_CHUNK_DAYS);
+  if (h->num_chunks == 0) {
+    h->base_chunk = chunk;
+    h->first_day = h->last_day = NO_DAY;
+  }
+  // grow the chunk table towards the new day, on either side
+  if (chunk < h->base_chunk || chunk >= h->base_chunk + h->num_chunks) {
+    int lo = chunk < h->base_chunk ? chunk : h->base_chunk;
+    int hi = chunk >= h->base_chunk + h->num_chunks
+                 ? chunk
+                 : h->base_chunk + h->num_chunks - 1;
+    int **grown = calloc(hi - lo + 1, sizeof(int *));
+    if (!grown)
+      return;
+    if (h->num_chunks)
+      memcpy(grown + (h->base_chunk - lo), h->chunks,
+             h->num_chunks * sizeof(int *));
+    free(h->chunks);
+    h->chunks = grown;
+    h->base_chunk = lo;
+    h->num_chunks = hi - lo + 1;
+  }
+  int c = chunk - h->base_chunk;
+  if (!h->chunks[c]) {
+    h->chunks[c] = calloc(HISTORY_CHUNK_DAYS, sizeof(int));
+    if (!h->chunks[c])
+      return;
+  }
+  h->chunks[c][day - chunk * HISTORY_CHUNK_DAYS] = sessions;
+  if (sessions > 0) {
+    if (h->first_day == NO_DAY || day < h->first_day)
+      h->first_day = day;
+    if (h->last_day == NO_DAY || day > h->last_day)
+      h->last_day = day;
+  }
+}
+
+void history_free(History *h) {
+  for (int i = 0; i < h->num_chunks; i++)
+    free(h->chunks[i]);
+  free(h->chunks);
+  memset(h, 0, sizeof(*h));
+  h->first_day = h->last_day = NO_DAY;
+}
+
+// Deep copy, for handing a streak to another thread. False if out of memory.
+bool history_copy(History *dst, const History *src) {
+  *dst = *src;
+  dst->chunks = calloc(src->num_chunks ? src->num_chunks : 1, sizeof(int *));
+  if (!dst->chunks)
+    return false;
+  for (int i = 0; i < src->num_chunks; i++) {
+    if (!src->chunks[i])
+      continue;
+    dst->chunks[i] = malloc(HISTORY_CHUNK_DAYS * sizeof(int));
+    if (!dst->chunks[i]) {
+      history_free(dst);
+      return false;
+    }
+    memcpy(dst->chunks[i], src->chunks[i], HISTORY_CHUNK_DAYS * sizeof(int));
+  }
+  return true;
+}
+
+// Writes the snapshot next to the file and renames it over, so a crash
+// leaves either the old or the new snapshot. Returns false if it didn't land.
+bool save_streak(const Streak *s) {
+  const char *tmp = STREAK_PATH ".tmp";
+  FILE *f = fopen(tmp, "w");
+  if (!f)
+    return false;
+  char date[11];
+  format_day(s->last_day, date);
+  fprintf(f, "last_date=%s\n", date);
+  fprintf(f, "daily_sessions=%d\n", s->daily_sessions);
+  fprintf(f, "consecutive_days=%d\n", s->consecutive_days);
+  fprintf(f, "journal_seq=%lu\n", s->journal_seq);
+  const History *h = &s->history;
+  if (h->num_chunks && h->first_day != NO_DAY) {
+    for (int day = h->first_day; day <= h->last_day; day++) {
+      int sessions = history_get(h, day);
+      if (sessions > 0) {
+        format_day(day, date);
+        fprintf(f, "h:%s=%d\n", date, sessions);
+      }
+    }
+  }
+  bool ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(tmp, STREAK_PATH) != 0) {
+    remove(tmp);
+    return false;
+  }
+  return true;
+}
+
+void load_streak(Streak *s) {
+  s->last_day = NO_DAY;
+  s->daily_sessions = 0;
+  s->consecutive_days = 0;
+  s->journal_seq = 0;
+  history_free(&s->history);
+
+  FILE *f = fopen(STREAK_PATH, "r");
+  if (!f)
+    return;
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    char d[11];
+    int sess, day;
+    if (sscanf(line, "last_date=%10s", d) == 1) {
+      if (!parse_day(d, &s->last_day))
+        s->last_day = NO_DAY;
+      continue;
+    }
+    if (sscanf(line, "daily_sessions=%d", &s->daily_sessions) == 1)
+      continue;
+    if (sscanf(line, "consecutive_days=%d", &s->consecutive_days) == 1)
+      continue;
+    if (sscanf(line, "journal_seq=%lu", &s->journal_seq) == 1)
+      continue;
+    if (sscanf(line, "h:%10[^=]=%d", d, &sess) == 2 && parse_day(d, &day))
+      history_set(&s->history, day, sess);
+  }
+  fclose(f);
+  s->revision++;
+}
+
+// Counts one finished work session on the given local day.
+void apply_session(Streak *s, int day) {
+  if (s->last_day == day) {
+    s->daily_sessions++;
+  } else {
+    // Check if it was yesterday. Calendar days, so DST changes and the time
+    // of day don't matter.
+    if (s->last_day != NO_DAY && day - s->last_day == 1) {
+      s->consecutive_days++;
+    } else {
+      s->consecutive_days = 1;
+    }
+    s->daily_sessions = 1;
+    s->last_day = day;
+  }
+  history_set(&s->history, day, s->daily_sessions);
+  s->revision++;
+}
+
+// Session journal. Instead of rewriting streak.txt after every session we
+// append one line per event to streak.journal:
+//
+//   <seq> <unix time> <event> <phase> <flag>
+//
+// and fold the journal back into the streak.txt snapshot every
+// JOURNAL_COMPACT_RECORDS records (and at startup). The snapshot remembers
+// the last seq it contains, so a crash between writing the snapshot and
+// truncating the journal doesn't count sessions twice. A record only goes
+// to disk as a whole line; a torn last line is dropped on replay.
+//
+// A phase end is held back until the start of the next phase, which
+// update_timer() logs right after it, and the two go out in one write()
+// followed by an fsync, so a finished session is on disk before we move
+// on. Everything else is just a write(); the config writer thread fsyncs
+// whatever was appended in the last JOURNAL_SYNC_MS with one call. It also
+// writes the compaction snapshot. Without that thread both happen inline.
+#define JOURNAL_COMPACT_RECORDS 256
+
+typedef enum {
+  JOURNAL_START = 'S', // a phase started from the top
+  JOURNAL_END = 'E',   // a phase ran out
+  JOURNAL_PAUSE = 'P', // flag: 1 paused, 0 resumed
+  JOURNAL_AWAY = 'A',  // flag: 1 went away, 0 came back
+} JournalEvent;
+
+typedef enum { PHASE_WORK, PHASE_BREAK, PHASE_LONG_BREAK } Phase;
+
+typedef struct {
+  int fd;
+  unsigned long next_seq; // appends hold config_writer.lock when it exists
+  int records;            // appended since the last compaction
+  char held[256];         // an END waiting for the START after it
+  int held_len;
+} Journal;
+
+Journal journal = {-1};
+
+void apply_journal_record(Streak *s, JournalEvent ev, Phase phase,
+                          time_t when) {
+  if (ev == JOURNAL_END && phase == PHASE_WORK)
+    apply_session(s, local_day(when));
+}
+
+// Writes the snapshot and empties the journal, unless records were appended
+// after the snapshot was taken; those stay and the next compaction gets them.
+void fold_journal(const Streak *s) {
+  ConfigWriter *cw = &config_writer;
+  if (!save_streak(s)) {
+    fprintf(stderr, "Failed to write %s\n", STREAK_PATH);
+    return;
+  }
+  if (cw->lock)
+    SDL_LockMutex(cw->lock);
+  if (journal.next_seq - 1 == s->journal_seq && ftruncate(journal.fd, 0) != 0)
+    fprintf(stderr, "Failed to truncate %s\n", JOURNAL_PATH);
+  if (cw->lock)
+    SDL_UnlockMutex(cw->lock);
+}
+
+// The config writer's end of compaction; takes ownership of snap.
+void fold_journal_copy(Streak *snap) {
+  fold_journal(snap);
+  history_free(&snap->history);
+  free(snap);
+}
+
+void compact_journal(Streak *s) {
+  ConfigWriter *cw = &config_writer;
+  s->journal_seq = journal.next_seq - 1;
+  journal.records = 0;
+  Streak *snap = cw->thread ? malloc(sizeof(*snap)) : NULL;
+  if (snap) {
+    *snap = *s;
+    if (!history_copy(&snap->history, &s->history)) {
+      free(snap);
+      snap = NULL;
+    }
+  }
+  if (!snap) {
+    fold_journal(s);
+    return;
+  }
+  SDL_LockMutex(cw->lock);
+  if (cw->snapshot) { // never picked up, the new one supersedes it
+    history_free(&cw->snapshot->history);
+    free(cw->snapshot);
+  }
+  cw->snapshot = snap;
+  SDL_CondSignal(cw->cond);
+  SDL_UnlockMutex(cw->lock);
+}
+
+// Loads the streak.txt snapshot, replays the journal on top of it and
+// opens the journal for appending.
+void open_journal(Streak *s) {
+  load_streak(s);
+  journal.next_seq = s->journal_seq + 1;
+
+  int fd = open(JOURNAL_PATH, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Failed to open %s\n", JOURNAL_PATH);
+    return;
+  }
+  FILE *f = fdopen(dup(fd), "r");
+  off_t good = 0; // end of the last complete record
+  int replayed = 0;
+  if (f) {
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+      size_t len = strlen(line);
+      if (len == 0 || line[len - 1] != '\n')
+        break; // torn write, everything from here on is garbage
+      unsigned long seq;
+      long long when;
+      char ev;
+      int phase, flag;
+      if (sscanf(line, "%lu %lld %c %d %d", &seq, &when, &ev, &phase,
+                 &flag) != 5)
+        break;
+      good += len;
+      if (seq >= journal.next_seq)
+        journal.next_seq = seq + 1;
+      if (seq <= s->journal_seq)
+        continue; // already in the snapshot
+      apply_journal_record(s, ev, phase, (time_t)when);
+      replayed++;
+    }
+    fclose(f);
+  }
+  if (ftruncate(fd, good) != 0)
+    fprintf(stderr, "Failed to trim %s\n", JOURNAL_PATH);
+  journal.fd = fd;
+  config_writer.journal_fd = fd;
+  journal.records = replayed;
+  if (replayed)
+    compact_journal(s);
+}
+
+void journal_append(Streak *s, JournalEvent ev, Phase phase, int flag) {
+  time_t now = wall_now();
+  apply_journal_record(s, ev, phase, now);
+  if (journal.fd < 0)
+    return;
+
+  ConfigWriter *cw = &config_writer;
+  if (cw->lock)
+    SDL_LockMutex(cw->lock);
+  bool after_end = journal.held_len > 0;
+  journal.held_len += snprintf(
+      journal.held + journal.held_len, sizeof(journal.held) - journal.held_len,
+      "%lu %lld %c %d %d\n", journal.next_seq++, (long long)now, ev, phase,
+      flag);
+  bool ok = true, sync_now = false;
+  if (ev != JOURNAL_END) {
+    ok = write(journal.fd, journal.held, journal.held_len) == journal.held_len;
+    journal.held_len = 0;
+    sync_now = after_end || !cw->thread;
+    if (sync_now) {
+      cw->journal_dirty = false; // our fsync covers those too
+    } else if (ok && !cw->journal_dirty) {
+      cw->journal_dirty = true;
+      cw->journal_since = SDL_GetTicks();
+      SDL_CondSignal(cw->cond);
+    }
+  }
+  if (cw->lock)
+    SDL_UnlockMutex(cw->lock);
+  if (!ok) {
+    fprintf(stderr, "Failed to append to %s\n", JOURNAL_PATH);
+    return;
+  }
+  if (sync_now && fsync(journal.fd) != 0)
+    fprintf(stderr, "Failed to sync %s\n", JOURNAL_PATH);
+  journal.records++;
+  if (journal.records >= JOURNAL_COMPACT_RECORDS)
+    compact_journal(s);
+}
+
+void close_journal(void) {
+  if (journal.fd < 0)
+    return;
+  // the config writer is stopped by now, whatever it didn't sync is ours
+  if (journal.held_len &&
+      write(journal.fd, journal.held, journal.held_len) != journal.held_len)
+    fprintf(stderr, "Failed to append to %s\n", JOURNAL_PATH);
+  journal.held_len = 0;
+  fsync(journal.fd);
+  close(journal.fd);
+  journal.fd = -1;
+}
+
+Phase timer_phase(const Timer *timer) {
+  if (timer->state == w)
+    return PHASE_WORK;
+  // session_count was bumped when the work session ended
+  if (timer->session_count > 0 &&
+      timer->session_count % timer->config.sessions_until_long == 0)
+    return PHASE_LONG_BREAK;
+  return PHASE_BREAK;
+}
+
+// User hooks: shell commands run on timer events, from hooks.cfg, one per
+// line:
+//
+//   <event> <timeout seconds> <command>
+//   work_end 10 notify-send "break time"
+//
+// Events are work_end, break_end, pause, resume, away and back. Commands
+// run under /bin/sh with stdin from /dev/null and the timer state in
+// POMO_EVENT, POMO_PHASE, POMO_REMAINING, POMO_SESSIONS, POMO_TODAY and
+// POMO_STREAK. They're spawned and reaped by a worker thread, so a slow
+// hook never holds up a frame; the main thread only queues them.
+#define HOOKS_PATH "hooks.cfg"
+#define HOOK_QUEUE 16      // runs waiting to start; past that they're dropped
+#define HOOK_MAX_RUNNING 4 // at once
+#define HOOK_POLL_MS 100   // how often running hooks get checked on
+#define HOOK_ENV 6
+
+typedef enum {
+  HOOK_WORK_END,
+  HOOK_BREAK_END,
+  HOOK_PAUSE,
+  HOOK_RESUME,
+  HOOK_AWAY,
+  HOOK_BACK,
+  HOOK_EVENTS
+} HookEvent;
+
+const char *hook_event_names[HOOK_EVENTS] = {
+    "work_end", "break_end", "pause", "resume", "away", "back"};
+
+typedef struct {
+  HookEvent event;
+  int timeout_ms;
+  char cmd[256];
+} Hook;
+
+typedef struct {
+  int hook; // index into hooks
+  char env[HOOK_ENV][48];
+} HookJob;
+
+typedef struct {
+  pid_t pid; // also its process group
+  int hook;
+  uint32_t deadline; // SDL_GetTicks()
+  bool killed;
+} HookChild;
+
+typedef struct {
+  Hook *hooks; // read-only once the thread runs
+  int count;
+  bool has_event[HOOK_EVENTS];
+  SDL_Thread *thread;
+  SDL_mutex *lock;
+  SDL_cond *cond;
+  bool quit;
+  HookJob queue[HOOK_QUEUE]; // ring, guarded by lock
+  int head, len;
+  HookChild running[HOOK_MAX_RUNNING]; // worker thread only
+  int num_running;
+} HookRunner;
+
+HookRunner hook_runner;
+
+extern char **environ;
+
+void spawn_hook(HookRunner *hr, const HookJob *job) {
+  const Hook *hook = &hr->hooks[job->hook];
+  int n = 0;
+  while (environ[n])
+    n++;
+  char **envp = malloc((n + HOOK_ENV + 1) * sizeof(char *));
+  if (!envp)
+    return;
+  memcpy(envp, environ, n * sizeof(char *));
+  for (int i = 0; i < HOOK_ENV; i++)
+    envp[n + i] = (char *)job->env[i];
+  envp[n + HOOK_ENV] = NULL;
+
+  // own process group so a timeout takes out whatever the shell started,
+  // and undo what SDL and the daemon did to signals
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  sigset_t none, defaults;
+  sigemptyset(&none);
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGPIPE);
+  sigaddset(&defaults, SIGINT);
+  sigaddset(&defaults, SIGTERM);
+  posix_spawnattr_setsigmask(&attr, &none);
+  posix_spawnattr_setsigdefault(&attr, &defaults);
+  posix_spawnattr_setpgroup(&attr, 0);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP |
+                                      POSIX_SPAWN_SETSIGMASK |
+                                      POSIX_SPAWN_SETSIGDEF);
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+                                   O_RDONLY, 0);
+
+  char *argv[] = {"sh", "-c", (char *)hook->cmd, NULL};
+  pid_t pid;
+  int err = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, envp);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  free(envp);
+  if (err) {
+    fprintf(stderr, "Hook '%s' failed to start: %s\n", hook->cmd,
+            strerror(err));
+    return;
+  }
+  hr->running[hr->num_running++] =
+      (HookChild){pid, job->hook, SDL_GetTicks() + hook->timeout_ms, false};
+}
+
+// Collects finished hooks and kills overdue ones, without blocking.
+void reap_hooks(HookRunner *hr) {
+  for (int i = 0; i < hr->num_running;) {
+    HookChild *c = &hr->running[i];
+    const Hook *hook = &hr->hooks[c->hook];
+    int status;
+    pid_t r = waitpid(c->pid, &status, WNOHANG);
+    if (r == 0) {
+      if (!c->killed && (int32_t)(SDL_GetTicks() - c->deadline) >= 0) {
+        fprintf(stderr, "Hook '%s' timed out, killing it\n", hook->cmd);
+        kill(-c->pid, SIGKILL);
+        c->killed = true;
+      }
+      i++;
+      continue;
+    }
+    if (r > 0 && !c->killed && WIFEXITED(status) && WEXITSTATUS(status))
+      fprintf(stderr, "Hook '%s' exited with %d\n", hook->cmd,
+              WEXITSTATUS(status));
+    *c = hr->running[--hr->num_running];
+  }
+}
+
+int hook_runner_thread(void *data) {
+  HookRunner *hr = data;
+  SDL_LockMutex(hr->lock);
+  while (!hr->quit) {
+    while (hr->len && hr->num_running < HOOK_MAX_RUNNING) {
+      HookJob job = hr->queue[hr->head];
+      hr->head = (hr->head + 1) % HOOK_QUEUE;
+      hr->len--;
+      SDL_UnlockMutex(hr->lock);
+      spawn_hook(hr, &job);
+      SDL_LockMutex(hr->lock);
+    }
+    if (hr->num_running) {
+      SDL_UnlockMutex(hr->lock);
+      reap_hooks(hr);
+      SDL_LockMutex(hr->lock);
+    }
+    if (hr->quit)
+      break;
+    if (hr->num_running)
+      SDL_CondWaitTimeout(hr->cond, hr->lock, HOOK_POLL_MS);
+    else if (!hr->len)
+      SDL_CondWait(hr->cond, hr->lock);
+  }
+  SDL_UnlockMutex(hr->lock);
+  return 0;
+}
+
+void load_hooks(void) {
+  FILE *f = fopen(HOOKS_PATH, "r");
+  if (!f)
+    return;
+  HookRunner *hr = &hook_runner;
+  char line[320];
+  while (fgets(line, sizeof(line), f)) {
+    char event[16], cmd[256];
+    int timeout;
+    if (line[0] == '#' ||
+        sscanf(line, "%15s %d %255[^\n]", event, &timeout, cmd) != 3)
+      continue;
+    int ev = 0;
+    while (ev < HOOK_EVENTS && strcmp(event, hook_event_names[ev]) != 0)
+      ev++;
+    if (ev == HOOK_EVENTS || timeout <= 0) {
+      fprintf(stderr, "%s: skipping '%s'\n", HOOKS_PATH, event);
+      continue;
+    }
+    Hook *hooks = realloc(hr->hooks, (hr->count + 1) * sizeof(Hook));
+    if (!hooks)
+      break;
+    hr->hooks = hooks;
+    Hook *h = &hooks[hr->count++];
+    h->event = ev;
+    h->timeout_ms = timeout * 1000;
+    snprintf(h->cmd, sizeof(h->cmd), "%s", cmd);
+    hr->has_event[ev] = true;
+  }
+  fclose(f);
+}
+
+void start_hook_runner(void) {
+  HookRunner *hr = &hook_runner;
+  load_hooks();
+  if (!hr->count)
+    return;
+  hr->lock = SDL_CreateMutex();
+  hr->cond = SDL_CreateCond();
+  if (hr->lock && hr->cond)
+    hr->thread = SDL_CreateThread(hook_runner_thread, "hooks", hr);
+  if (!hr->thread) {
+    fprintf(stderr, "Hook thread failed, hooks are off: %s\n",
+            SDL_GetError());
+    memset(hr->has_event, 0, sizeof(hr->has_event));
+    return;
+  }
+  verbose_log("Loaded %d hooks from %s\n", hr->count, HOOKS_PATH);
+}
+
+// Hooks still running are left to finish on their own.
+void stop_hook_runner(void) {
+  HookRunner *hr = &hook_runner;
+  if (hr->thread) {
+    SDL_LockMutex(hr->lock);
+    hr->quit = true;
+    SDL_CondSignal(hr->cond);
+    SDL_UnlockMutex(hr->lock);
+    SDL_WaitThread(hr->thread, NULL);
+    hr->thread = NULL;
+  }
+  if (hr->cond)
+    SDL_DestroyCond(hr->cond);
+  if (hr->lock)
+    SDL_DestroyMutex(hr->lock);
+  free(hr->hooks);
+  memset(hr, 0, sizeof(*hr));
+}
+
+void run_hooks(const Timer *timer, HookEvent ev) {
+  HookRunner *hr = &hook_runner;
+  if (!hr->has_event[ev])
+    return;
+  static const char *phases[] = {"work", "break", "long_break"};
+  const Streak *streak = &timer->streak;
+  int today =
+      streak->last_day == local_day(wall_now()) ? streak->daily_sessions : 0;
+  // work_end fires before update_timer bumps session_count, but the
+  // journal append already counted the session into the streak
+  int sessions = timer->session_count + (ev == HOOK_WORK_END);
+  HookJob job;
+  snprintf(job.env[0], sizeof(job.env[0]), "POMO_EVENT=%s",
+           hook_event_names[ev]);
+  snprintf(job.env[1], sizeof(job.env[1]), "POMO_PHASE=%s",
+           phases[timer_phase(timer)]);
+  snprintf(job.env[2], sizeof(job.env[2]), "POMO_REMAINING=%.0f",
+           fmax(timer->sec_remain, 0));
+  snprintf(job.env[3], sizeof(job.env[3]), "POMO_SESSIONS=%d", sessions);
+  snprintf(job.env[4], sizeof(job.env[4]), "POMO_TODAY=%d", today);
+  snprintf(job.env[5], sizeof(job.env[5]), "POMO_STREAK=%d",
+           streak->consecutive_days);
+
+  SDL_LockMutex(hr->lock);
+  for (int i = 0; i < hr->count; i++) {
+    if (hr->hooks[i].event != ev)
+      continue;
+    if (hr->len == HOOK_QUEUE) {
+      fprintf(stderr, "Hook queue full, dropping '%s'\n", hr->hooks[i].cmd);
+      continue;
+    }
+    job.hook = i;
+    hr->queue[(hr->head + hr->len++) % HOOK_QUEUE] = job;
+  }
+  SDL_CondSignal(hr->cond);
+  SDL_UnlockMutex(hr->lock);
+}
+
+void log_event(Timer *timer, JournalEvent ev, int flag) {
+  journal_append(&timer->streak, ev, timer_phase(timer), flag);
+  if (ev == JOURNAL_END)
+    run_hooks(timer, timer->state == w ? HOOK_WORK_END : HOOK_BREAK_END);
+  else if (ev == JOURNAL_PAUSE)
+    run_hooks(timer, flag ? HOOK_PAUSE : HOOK_RESUME);
+  else if (ev == JOURNAL_AWAY)
+    run_hooks(timer, flag ? HOOK_AWAY : HOOK_BACK);
+}
+
+// res/timer.mp3 is a 25 min work segment followed by a 5 min break segment.
+// Each phase loops its own segment for as long as the phase lasts, whatever
+// work_min/break_min are.
+#define TRACK_WORK_START 0.0
+#define TRACK_WORK_LEN 1500.0
+#define TRACK_BREAK_START 1500.0
+#define TRACK_BREAK_LEN 300.0
+
+typedef enum { SEGMENT_WORK, SEGMENT_BREAK } Segment;
+
+// Soundtrack position. The mixer's post-mix callback counts the music frames
+// it actually played and does the segment loop and phase seeks itself, so
+// the main thread never polls the music position or seeks the decoder; it
+// just asks for a segment and how far into the phase we are.
+typedef struct {
+  int rate;        // frames per second, 0 until the mixer is open
+  int frame_bytes; // bytes per frame in the mixer's format
+  Uint16 format;
+  SDL_atomic_t request; // (generation << 1) | segment, set by main thread
+  SDL_atomic_t request_ms; // phase time to start at, set before request
+  int applied;             // last request seen by the audio thread
+  Uint64 segment_frames; // audio thread only
+  bool cached;           // playing from sound_cache, audio thread only
+  Uint32 cursor;         // byte offset into the cached pcm, audio thread only
+} AudioClock;
+
+AudioClock audio_clock;
+
+// The soundtrack starts out streaming through Mix_Music. Meanwhile a worker
+// decodes the head of each loop region, work and break, to PCM in the
+// device format, splitting what audio_cache_mb holds between them, and
+// while the position is inside a head the audio thread plays it through a
+// music hook that copies straight from memory. Every phase (and every loop
+// of it) starts at the top of its region, so phase changes cost no decoder
+// seek; past the end of a head it hands back to the stream. At 48 kHz float
+// stereo the default 32 MB is about 44 s of each.
+//
+// The decoder reads the file through a source that covers just one head,
+// from the frame nearest its start to the byte where its budget runs out,
+// so it never decodes more than it keeps. The file maps to time linearly
+// enough for that (exactly for CBR), and MP3 frames resync, so the break
+// head decodes fine from the middle of the file. The source ends at once
+// when the cache is cancelled, so the worker never has to be waited on.
+// The cache outlives the device; it's only redone if the device comes back
+// in another format.
+typedef struct {
+  SDL_Thread *thread;
+  Mix_Chunk *pcm[2];   // by Segment, owned by the worker until ready is set
+  SDL_atomic_t ready;  // pcm is decoded and may be played
+  SDL_atomic_t busy;   // the worker is still decoding
+  SDL_atomic_t cancel; // makes the worker's reads end early
+  Uint32 limit;        // bytes, both heads together
+} SoundCache;
+
+SoundCache sound_cache;
+
+double segment_start(Segment seg) {
+  return seg == SEGMENT_WORK ? TRACK_WORK_START : TRACK_BREAK_START;
+}
+
+double segment_length(Segment seg) {
+  return seg == SEGMENT_WORK ? TRACK_WORK_LEN : TRACK_BREAK_LEN;
+}
+
+Uint32 segment_byte(double sec) {
+  return (Uint32)(sec * audio_clock.rate) * audio_clock.frame_bytes;
+}
+
+// How much of seg's head to keep, whole frames only. The break gets half of
+// limit, or all of its region if that's less, and the work the rest.
+Uint32 cache_bytes(Uint32 limit, Segment seg) {
+  Uint32 brk = segment_byte(TRACK_BREAK_LEN);
+  if (brk > limit / 2)
+    brk = limit / 2;
+  Uint32 want = seg == SEGMENT_BREAK ? brk : limit - brk;
+  Uint32 whole = segment_byte(segment_length(seg));
+  if (want > whole)
+    want = whole;
+  return want - want % audio_clock.frame_bytes;
+}
+
+// Bytes of seg's head that can be played from memory, 0 if none.
+Uint32 cached_bytes(Segment seg) {
+  if (!SDL_AtomicGet(&sound_cache.ready) || !sound_cache.pcm[seg])
+    return 0;
+  return sound_cache.pcm[seg]->alen;
+}
+
+typedef struct {
+  SDL_RWops *file;
+  Sint64 begin, end; // the decoder sees only these bytes
+} CacheSource;
+
+Sint64 cache_source_size(SDL_RWops *rw) {
+  CacheSource *src = rw->hidden.unknown.data1;
+  return src->end - src->begin;
+}
+
+Sint64 cache_source_seek(SDL_RWops *rw, Sint64 offset, int whence) {
+  CacheSource *src = rw->hidden.unknown.data1;
+  if (whence == RW_SEEK_END)
+    offset += src->end - src->begin;
+  else if (whence == RW_SEEK_CUR)
+    offset += SDL_RWtell(src->file) - src->begin;
+  if (offset < 0)
+    offset = 0;
+  if (offset > src->end - src->begin)
+    offset = src->end - src->begin;
+  Sint64 pos = SDL_RWseek(src->file, src->begin + offset, RW_SEEK_SET);
+  return pos < 0 ? pos : pos - src->begin;
+}
+
+size_t cache_source_read(SDL_RWops *rw, void *ptr, size_t size, size_t num) {
+  CacheSource *src = rw->hidden.unknown.data1;
+  Sint64 left = src->end - SDL_RWtell(src->file);
+  if (left <= 0 || size == 0 || SDL_AtomicGet(&sound_cache.cancel))
+    return 0;
+  if ((Sint64)(size * num) > left)
+    num = left / size;
+  return SDL_RWread(src->file, ptr, size, num);
+}
+
+size_t cache_source_write(SDL_RWops *rw, const void *ptr, size_t size,
+                          size_t num) {
+  (void)rw;
+  (void)ptr;
+  (void)size;
+  (void)num;
+  return 0;
+}
+
+int cache_source_close(SDL_RWops *rw) {
+  CacheSource *src = rw->hidden.unknown.data1;
+  int ret = SDL_RWclose(src->file);
+  free(src);
+  SDL_FreeRW(rw);
+  return ret;
+}
+
+// Length of the MPEG audio layer III frame with header h, 0 if h isn't one.
+int mp3_frame_len(const Uint8 *h) {
+  static const int kbps[2][15] = {
+      {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+      {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}};
+  static const int hz[3] = {44100, 48000, 32000};
+  int version = (h[1] >> 3) & 3; // 3 MPEG-1, 2 MPEG-2, 0 MPEG-2.5
+  int bitrate = h[2] >> 4, rate = (h[2] >> 2) & 3;
+  if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0 || version == 1 ||
+      ((h[1] >> 1) & 3) != 1 || bitrate == 0 || bitrate == 15 || rate == 3)
+    return 0;
+  bool mpeg1 = version == 3;
+  int sample_rate = hz[rate] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+  return (mpeg1 ? 144 : 72) * kbps[!mpeg1][bitrate] * 1000 / sample_rate +
+         ((h[2] >> 1) & 1);
+}
+
+// Offset of the first frame at or after from whose successor also starts
+// with a frame header, so a stray 0xFF in the audio data doesn't count.
+Sint64 find_mp3_frame(SDL_RWops *file, Sint64 from) {
+  Uint8 buf[8192];
+  SDL_RWseek(file, from, RW_SEEK_SET);
+  size_t n = SDL_RWread(file, buf, 1, sizeof(buf));
+  for (size_t i = 0; i + 4 <= n; i++) {
+    int len = mp3_frame_len(buf + i);
+    if (len && i + len + 4 <= n && mp3_frame_len(buf + i + len))
+      return from + i;
+  }
+  return -1;
+}
+
+// The part of path holding [start, start + length) seconds of the track,
+// as far as the decoder is concerned.
+SDL_RWops *open_cache_source(const char *path, double start, double length) {
+  SDL_RWops *file = SDL_RWFromFile(path, "rb");
+  if (!file)
+    return NULL;
+  double per_sec = SDL_RWsize(file) / (TRACK_WORK_LEN + TRACK_BREAK_LEN);
+  Sint64 begin = start > 0 ? find_mp3_frame(file, start * per_sec) : 0;
+  CacheSource *src = begin >= 0 ? malloc(sizeof(CacheSource)) : NULL;
+  SDL_RWops *rw = src ? SDL_AllocRW() : NULL;
+  if (!rw) {
+    free(src);
+    SDL_RWclose(file);
+    return NULL;
+  }
+  src->file = file;
+  src->begin = begin;
+  src->end = begin + (Sint64)(length * per_sec);
+  SDL_RWseek(file, begin, RW_SEEK_SET);
+  rw->size = cache_source_size;
+  rw->seek = cache_source_seek;
+  rw->read = cache_source_read;
+  rw->write = cache_source_write;
+  rw->close = cache_source_close;
+  rw->hidden.unknown.data1 = src;
+  return rw;
+}
+
+// Decodes the head of seg, or returns NULL if there's no budget for it, it
+// failed or the cache was cancelled.
+Mix_Chunk *decode_cache_head(Segment seg) {
+  Uint32 want = cache_bytes(sound_cache.limit, seg);
+  if (!want)
+    return NULL;
+  double length = (double)want / (audio_clock.rate * audio_clock.frame_bytes);
+  SDL_RWops *src =
+      open_cache_source(SOUNDTRACK_PATH, segment_start(seg), length);
+  Mix_Chunk *pcm = src ? Mix_LoadWAV_RW(src, 1) : NULL;
+  if (pcm && SDL_AtomicGet(&sound_cache.cancel)) {
+    Mix_FreeChunk(pcm);
+    return NULL;
+  }
+  if (!pcm) {
+    if (!SDL_AtomicGet(&sound_cache.cancel))
+      fprintf(stderr, "Failed to decode %s, streaming it: %s\n",
+              SOUNDTRACK_PATH, Mix_GetError());
+    return NULL;
+  }
+  // whatever a VBR stretch adds on top gets trimmed
+  if (pcm->alen > want)
+    pcm->alen = want;
+  pcm->alen -= pcm->alen % audio_clock.frame_bytes;
+  return pcm;
+}
+
+int sound_cache_thread(void *data) {
+  (void)data;
+  Uint32 start = SDL_GetTicks();
+  Mix_Chunk *work = decode_cache_head(SEGMENT_WORK);
+  Mix_Chunk *brk = decode_cache_head(SEGMENT_BREAK);
+  if (SDL_AtomicGet(&sound_cache.cancel) || (!work && !brk)) {
+    if (work)
+      Mix_FreeChunk(work);
+    if (brk)
+      Mix_FreeChunk(brk);
+    SDL_AtomicSet(&sound_cache.busy, 0);
+    return 0;
+  }
+  double frame_rate = audio_clock.rate * audio_clock.frame_bytes;
+  verbose_log("Cached %.0f s of work and %.0f s of break in %u ms\n",
+              work ? work->alen / frame_rate : 0,
+              brk ? brk->alen / frame_rate : 0, SDL_GetTicks() - start);
+  sound_cache.pcm[SEGMENT_WORK] = work;
+  sound_cache.pcm[SEGMENT_BREAK] = brk;
+  SDL_AtomicSet(&sound_cache.ready, 1);
+  SDL_AtomicSet(&sound_cache.busy, 0);
+  return 0;
+}
+
+// Starts decoding unless there's a cache already or one on the way.
+void start_sound_cache(int limit_mb) {
+  if (!audio_clock.rate || limit_mb <= 0 || sound_cache.thread ||
+      SDL_AtomicGet(&sound_cache.ready))
+    return;
+  sound_cache.limit = (Uint32)limit_mb << 20;
+  SDL_AtomicSet(&sound_cache.cancel, 0);
+  SDL_AtomicSet(&sound_cache.busy, 1);
+  sound_cache.thread =
+      SDL_CreateThread(sound_cache_thread, "sound cache", NULL);
+  if (!sound_cache.thread) {
+    SDL_AtomicSet(&sound_cache.busy, 0);
+    fprintf(stderr, "Failed to start sound cache: %s\n", SDL_GetError());
+  }
+}
+
+// True once no worker is decoding. If one is, it's told to give up and
+// this returns false right away; call again later. The mixer has to stay
+// open until then, since the decode runs through it.
+bool sound_cache_idle(void) {
+  if (!sound_cache.thread)
+    return true;
+  if (SDL_AtomicGet(&sound_cache.busy)) {
+    SDL_AtomicSet(&sound_cache.cancel, 1);
+    return false;
+  }
+  SDL_WaitThread(sound_cache.thread, NULL); // already on its way out
+  sound_cache.thread = NULL;
+  return true;
+}
+
+// Drops the cache. The music hook must be off and no worker running.
+void free_sound_cache(void) {
+  SDL_AtomicSet(&sound_cache.ready, 0);
+  for (int i = 0; i < 2; i++) {
+    if (sound_cache.pcm[i])
+      Mix_FreeChunk(sound_cache.pcm[i]);
+    sound_cache.pcm[i] = NULL;
+  }
+}
+
+// Music hook used while the position is inside a cached head. The
+// Mix_Music stays loaded but idle; its playing/paused state still says
+// whether we should be audible. The cursor is a byte offset into the head.
+void cached_music_hook(void *udata, Uint8 *stream, int len) {
+  (void)udata;
+  AudioClock *ac = &audio_clock;
+  if (!Mix_PlayingMusic() || Mix_PausedMusic())
+    return;
+  Segment seg = ac->applied & 1;
+  Mix_Chunk *pcm = sound_cache.pcm[seg];
+  Uint32 end = segment_byte(segment_length(seg));
+  if (!pcm)
+    return;
+  if (end > pcm->alen)
+    end = pcm->alen;
+  if (end == 0)
+    return;
+  int volume = Mix_VolumeMusic(-1);
+  while (len > 0) {
+    if (ac->cursor >= end)
+      ac->cursor = 0;
+    Uint32 n = end - ac->cursor;
+    if (n > (Uint32)len)
+      n = len;
+    SDL_MixAudioFormat(stream, pcm->abuf + ac->cursor, ac->format, n, volume);
+    stream += n;
+    len -= n;
+    ac->cursor += n;
+  }
+}
+
+// True if the next len bytes of seg from the current position are cached.
+bool next_buffer_cached(const AudioClock *ac, Segment seg, int len) {
+  Uint32 alen = cached_bytes(seg);
+  if (alen >= segment_byte(segment_length(seg)))
+    return true; // the whole region, wrapping included
+  return (Uint32)ac->segment_frames * ac->frame_bytes + (Uint32)len <= alen;
+}
+
+// Plays the next buffer from the cache if all of it is cached, from the
+// stream otherwise. Deciding a buffer ahead keeps the hand-over gapless.
+void pick_music_source(AudioClock *ac, Segment seg, int len) {
+  bool inside = next_buffer_cached(ac, seg, len);
+  if (inside && !ac->cached) {
+    ac->cached = true;
+    ac->cursor = (Uint32)ac->segment_frames * ac->frame_bytes;
+    Mix_HookMusic(cached_music_hook, NULL);
+  } else if (!inside && ac->cached) {
+    ac->cached = false;
+    Mix_HookMusic(NULL, NULL);
+    Mix_SetMusicPosition(segment_start(seg) +
+                         (double)ac->segment_frames / ac->rate);
+  }
+}
+
+void audio_clock_postmix(void *udata, Uint8 *stream, int len) {
+  (void)udata;
+  (void)stream;
+  AudioClock *ac = &audio_clock;
+  int request = SDL_AtomicGet(&ac->request);
+  Segment seg = request & 1;
+  double start = segment_start(seg);
+  double length = segment_length(seg);
+
+  if (Mix_PlayingMusic() && !Mix_PausedMusic()) {
+    ac->segment_frames += len / ac->frame_bytes;
+  }
+  Uint64 segment_len = (Uint64)(length * ac->rate);
+  if (request != ac->applied) {
+    ac->applied = request;
+    double offset = fmod(SDL_AtomicGet(&ac->request_ms) / 1000.0, length);
+    ac->segment_frames = (Uint64)(offset * ac->rate);
+    ac->cursor = (Uint32)ac->segment_frames * ac->frame_bytes;
+    // a cached head plays from memory, no need to move the decoder
+    if (!ac->cached && !next_buffer_cached(ac, seg, len))
+      Mix_SetMusicPosition(start + offset);
+  } else if (ac->segment_frames >= segment_len) {
+    ac->segment_frames -= segment_len;
+    // the hook wraps on its own, only the stream needs a seek, and not
+    // even that if the head it wraps to is cached
+    if (!ac->cached && !next_buffer_cached(ac, seg, len))
+      Mix_SetMusicPosition(start + (double)ac->segment_frames / ac->rate);
+  }
+  pick_music_source(ac, seg, len);
+}
+
+// Call with the music just started, after audio_clock_seek() has said where
+// the phase is now.
+void start_audio_clock(void) {
+  AudioClock *ac = &audio_clock;
+  int freq, channels;
+  Uint16 format;
+  if (!Mix_QuerySpec(&freq, &format, &channels))
+    return;
+  ac->frame_bytes = channels * SDL_AUDIO_BITSIZE(format) / 8;
+  ac->format = format;
+  ac->rate = freq;
+  ac->cached = false;
+
+  int request = SDL_AtomicGet(&ac->request);
+  Segment seg = request & 1;
+  double offset =
+      fmod(SDL_AtomicGet(&ac->request_ms) / 1000.0, segment_length(seg));
+  ac->applied = request;
+  ac->segment_frames = (Uint64)(offset * freq);
+  if (segment_start(seg) + offset > 0)
+    Mix_SetMusicPosition(segment_start(seg) + offset);
+  Mix_SetPostMix(audio_clock_postmix, NULL);
+}
+
+// Call with the device closed, so the audio thread is gone.
+void stop_audio_clock(void) {
+  AudioClock *ac = &audio_clock;
+  ac->rate = 0;
+  ac->cached = false;
+}
+
+// Moves the music to offset seconds into a phase playing seg, looping the
+// segment as needed. Cheap, the seek itself happens on the audio thread at
+// the next mix.
+void audio_clock_seek(Segment seg, double offset) {
+  SDL_AtomicSet(&audio_clock.request_ms, (int)(offset * 1000.0));
+  int gen = (SDL_AtomicGet(&audio_clock.request) >> 1) + 1;
+  SDL_AtomicSet(&audio_clock.request, (gen << 1) | seg);
+}
+
+// The countdown runs on absolute deadlines: while running, sec_remain is
+// derived from deadline - mono_now() every frame instead of accumulating
+// frame deltas, so it can't drift and a late frame can't skip anything.
+double mono_now(void) {
+  if (virtual_clock.on)
+    return virtual_clock.mono;
+  return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+// Unlike mono_now() this keeps counting while the machine is suspended, so
+// the gap between the two grows by exactly the time spent asleep.
+double suspend_clock(void) {
+#ifdef __linux__
+  struct timespec ts;
+  if (clock_gettime(CLOCK_BOOTTIME, &ts) == 0)
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+  // wall time; a manual clock change under SUSPEND_MIN_SEC is ignored
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+#define SUSPEND_MIN_SEC 5.0
+
+typedef enum {
+  SUSPEND_PAUSE,    // pause with the time left before the suspend
+  SUSPEND_CONTINUE, // the suspend counts, the phase may have ended
+  SUSPEND_RESTART,  // start the interrupted phase over
+} SuspendPolicy;
+
+// Seconds the machine was suspended since the last call, 0 if it wasn't.
+double check_suspend(Timer *timer) {
+  double offset = suspend_clock() - mono_now();
+  double slept = offset - timer->suspend_offset;
+  timer->suspend_offset = offset;
+  return slept >= SUSPEND_MIN_SEC ? slept : 0;
+}
+
+double phase_len(const Timer *timer) {
+  switch (timer_phase(timer)) {
+  case PHASE_WORK:
+    return timer->config.work_min * 60.0;
+  case PHASE_LONG_BREAK:
+    return timer->config.long_break_min * 60.0;
+  default:
+    return timer->config.break_min * 60.0;
+  }
+}
+
+// Points the soundtrack at where the running phase is, for when the music
+// wasn't there to follow it: the device just opened, or a suspend moved the
+// deadline.
+void sync_soundtrack(const Timer *timer, double now) {
+  double remain = timer->paused ? timer->sec_remain : timer->deadline - now;
+  audio_clock_seek(timer->state == w ? SEGMENT_WORK : SEGMENT_BREAK,
+                   fmax(phase_len(timer) - remain, 0));
+}
+
+void set_paused(Timer *timer, bool paused, double now) {
+  if (paused == timer->paused)
+    return;
+  if (paused) {
+    timer->sec_remain = timer->deadline - now;
+    timer->paused_at = now;
+  } else {
+    timer->deadline = now + timer->sec_remain;
+  }
+  timer->paused = paused;
+}
+
+void handle_suspend(Timer *timer, double slept, double now) {
+  verbose_log("Resumed after %.0f s suspended\n", slept);
+  switch (timer->config.suspend_policy) {
+  case SUSPEND_CONTINUE:
+    // the main loop ends the phase if this puts it in the past
+    if (!timer->paused) {
+      timer->deadline -= slept;
+      sync_soundtrack(timer, now);
+    }
+    break;
+  case SUSPEND_RESTART:
+    timer->sec_remain = phase_len(timer);
+    timer->deadline = now + timer->sec_remain;
+    sync_soundtrack(timer, now);
+    break;
+  default:
+    if (!timer->paused) {
+      set_paused(timer, true, now);
+      log_event(timer, JOURNAL_PAUSE, 1);
+    }
+    break;
+  }
+}
+
+// Starts the running phase over at its configured length, paused or not.
+void restart_phase(Timer *timer, double now) {
+  timer->sec_remain = phase_len(timer);
+  timer->deadline = now + timer->sec_remain;
+  log_event(timer, JOURNAL_START, 0);
+  audio_clock_seek(timer->state == w ? SEGMENT_WORK : SEGMENT_BREAK, 0);
+}
+
+// Hierarchical timer wheel: WHEEL_LEVELS wheels of 64 slots, each level 64
+// times coarser than the one below, ticking in milliseconds. An entry sits
+// in the level matching how far off it is and moves down as it gets close,
+// so adding, removing and expiring are O(1), and per-level bitmaps of the
+// non-empty slots tell how long we can sleep without walking any lists.
+// The advance/next-expiry bit tricks follow William Ahern's timeout.c.
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 5 // 2^30 ms, ~12 days; anything later gets re-placed
+#define WHEEL_MAX_TICKS ((1ull << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+typedef struct WheelEntry {
+  struct WheelEntry *next, *prev;
+  uint64_t expires; // tick
+  bool scheduled;   // on a slot or the expired list
+} WheelEntry;
+
+typedef struct {
+  WheelEntry slots[WHEEL_LEVELS][WHEEL_SLOTS]; // list heads
+  uint64_t pending[WHEEL_LEVELS];              // bit per non-empty slot
+  WheelEntry expired;                          // list head
+  uint64_t now;                                // tick
+} TimerWheel;
+
+void list_init(WheelEntry *head) { head->next = head->prev = head; }
+
+bool list_empty(const WheelEntry *head) { return head->next == head; }
+
+void list_push(WheelEntry *head, WheelEntry *e) {
+  e->prev = head->prev;
+  e->next = head;
+  head->prev->next = e;
+  head->prev = e;
+}
+
+void list_unlink(WheelEntry *e) {
+  e->prev->next = e->next;
+  e->next->prev = e->prev;
+  e->next = e->prev = e;
+}
+
+// Moves everything in from to the end of to.
+void list_splice(WheelEntry *to, WheelEntry *from) {
+  if (list_empty(from))
+    return;
+  from->next->prev = to->prev;
+  to->prev->next = from->next;
+  from->prev->next = to;
+  to->prev = from->prev;
+  list_init(from);
+}
+
+uint64_t rotl64(uint64_t v, int n) {
+  n &= 63;
+  return n ? (v << n) | (v >> (64 - n)) : v;
+}
+
+uint64_t rotr64(uint64_t v, int n) {
+  n &= 63;
+  return n ? (v >> n) | (v << (64 - n)) : v;
+}
+
+void wheel_init(TimerWheel *w) {
+  memset(w, 0, sizeof(*w));
+  for (int l = 0; l < WHEEL_LEVELS; l++)
+    for (int i = 0; i < WHEEL_SLOTS; i++)
+      list_init(&w->slots[l][i]);
+  list_init(&w->expired);
+}
+
+void wheel_remove(TimerWheel *w, WheelEntry *e) {
+  if (!e->scheduled)
+    return;
+  WheelEntry *next = e->next;
+  list_unlink(e);
+  e->scheduled = false;
+  // if that emptied a slot, clear its pending bit
+  if (list_empty(next)) {
+    for (int l = 0; l < WHEEL_LEVELS; l++) {
+      if (next >= w->slots[l] && next < w->slots[l] + WHEEL_SLOTS)
+        w->pending[l] &= ~(1ull << (next - w->slots[l]));
+    }
+  }
+}
+
+void wheel_place(TimerWheel *w, WheelEntry *e) {
+  e->scheduled = true;
+  if (e->expires <= w->now) {
+    list_push(&w->expired, e);
+    return;
+  }
+  uint64_t rem = e->expires - w->now;
+  if (rem > WHEEL_MAX_TICKS)
+    rem = WHEEL_MAX_TICKS;
+  int level = (63 - __builtin_clzll(rem)) / WHEEL_BITS;
+  // higher levels go one slot early so the entry gets moved down in time
+  int slot = ((e->expires >> (level * WHEEL_BITS)) - (level ? 1 : 0)) &
+             (WHEEL_SLOTS - 1);
+  list_push(&w->slots[level][slot], e);
+  w->pending[level] |= 1ull << slot;
+}
+
+void wheel_add(TimerWheel *w, WheelEntry *e, uint64_t expires) {
+  wheel_remove(w, e);
+  e->expires = expires;
+  wheel_place(w, e);
+}
+
+// Moves the wheel to now; entries that are due end up on w->expired.
+void wheel_advance(TimerWheel *w, uint64_t now) {
+  if (now <= w->now)
+    return;
+  uint64_t elapsed = now - w->now;
+  WheelEntry todo;
+  list_init(&todo);
+
+  for (int l = 0; l < WHEEL_LEVELS; l++) {
+    int shift = l * WHEEL_BITS;
+    uint64_t passed; // slots this level swept over
+    if ((elapsed >> shift) > WHEEL_SLOTS - 1) {
+      passed = ~0ull;
+    } else {
+      int steps = (elapsed >> shift) & (WHEEL_SLOTS - 1);
+      int from = (w->now >> shift) & (WHEEL_SLOTS - 1);
+      int to = (now >> shift) & (WHEEL_SLOTS - 1);
+      uint64_t span = (1ull << steps) - 1;
+      passed = rotl64(span, from);
+      passed |= rotr64(rotl64(span, to), steps);
+      passed |= 1ull << to;
+    }
+    uint64_t due = passed & w->pending[l];
+    while (due) {
+      int slot = __builtin_ctzll(due);
+      list_splice(&todo, &w->slots[l][slot]);
+      w->pending[l] &= ~(1ull << slot);
+      due &= due - 1;
+    }
+    // the level above only moves if this one wrapped past slot 0
+    if (!(passed & 1))
+      break;
+    if (elapsed < (uint64_t)WHEEL_SLOTS << shift)
+      elapsed = (uint64_t)WHEEL_SLOTS << shift;
+  }
+  w->now = now;
+  // re-place what we picked up: due ones expire, the rest move down
+  while (!list_empty(&todo)) {
+    WheelEntry *e = todo.next;
+    list_unlink(e);
+    wheel_place(w, e);
+  }
+}
+
+WheelEntry *wheel_pop_expired(TimerWheel *w) {
+  if (list_empty(&w->expired))
+    return NULL;
+  WheelEntry *e = w->expired.next;
+  list_unlink(e);
+  e->scheduled = false;
+  return e;
+}
+
+// Ticks we can sleep before the wheel needs advancing, UINT64_MAX if it's
+// empty. Can be early (an entry moving down a level), never late.
+uint64_t wheel_next(const TimerWheel *w) {
+  if (!list_empty(&w->expired))
+    return 0;
+  uint64_t best = UINT64_MAX, lower = 0;
+  for (int l = 0; l < WHEEL_LEVELS; l++) {
+    int shift = l * WHEEL_BITS;
+    if (w->pending[l]) {
+      int slot = (w->now >> shift) & (WHEEL_SLOTS - 1);
+      uint64_t t = (uint64_t)(__builtin_ctzll(rotr64(w->pending[l], slot)) +
+                              (l ? 1 : 0))
+                   << shift;
+      // minus how far the lower levels are into their rotation
+      t -= lower & w->now;
+      if (t < best)
+        best = t;
+    }
+    lower = (lower << WHEEL_BITS) | (WHEEL_SLOTS - 1);
+  }
+  return best;
+}
+
+// Extra timers next to the pomodoro, from timers.cfg, one per line:
+//
+//   countdown <minutes> <name>   runs once, 'r' on its view restarts it
+//   every <minutes> <name>       repeats, e.g. a stand-up reminder
+//
+// They all live on one timer wheel, so idle ones cost nothing and the
+// loop only wakes for the earliest. Tab cycles the main window through
+// them.
+#define TIMERS_PATH "timers.cfg"
+
+typedef struct {
+  WheelEntry entry; // first, so a fired entry is its countdown
+  char name[32];
+  uint64_t period; // ticks
+  bool repeat;
+} Countdown;
+
+typedef struct {
+  TimerWheel wheel;
+  Countdown *items;
+  int count;
+  double epoch; // mono_now() at tick 0
+} Countdowns;
+
+Countdowns countdowns;
+
+uint64_t countdown_ticks(double now) {
+  return (uint64_t)((now - countdowns.epoch) * 1000.0);
+}
+
+void restart_countdown(Countdown *c, double now) {
+  wheel_add(&countdowns.wheel, &c->entry, countdown_ticks(now) + c->period);
+}
+
+void load_countdowns(double now) {
+  wheel_init(&countdowns.wheel);
+  countdowns.epoch = now;
+  FILE *f = fopen(TIMERS_PATH, "r");
+  if (!f)
+    return;
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    char kind[16], name[32];
+    double minutes;
+    if (sscanf(line, "%15s %lf %31[^\n]", kind, &minutes, name) != 3 ||
+        minutes <= 0)
+      continue;
+    bool repeat = strcmp(kind, "every") == 0;
+    if (!repeat && strcmp(kind, "countdown") != 0)
+      continue;
+    Countdown *items =
+        realloc(countdowns.items, (countdowns.count + 1) * sizeof(Countdown));
+    if (!items)
+      break;
+    countdowns.items = items;
+    Countdown *c = &items[countdowns.count++];
+    memset(c, 0, sizeof(*c));
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    c->period = (uint64_t)(minutes * 60000.0);
+    c->repeat = repeat;
+  }
+  fclose(f);
+  // entries point into items, so only schedule once it stopped moving
+  for (int i = 0; i < countdowns.count; i++)
+    restart_countdown(&countdowns.items[i], now);
+  if (countdowns.count)
+    verbose_log("Loaded %d timers from %s\n", countdowns.count, TIMERS_PATH);
+}
+
+void free_countdowns(void) {
+  free(countdowns.items);
+  countdowns.items = NULL;
+  countdowns.count = 0;
+}
+
+// Advances the wheel and returns the next countdown that went off, or NULL.
+// Repeating ones are put back on the wheel for their next round.
+Countdown *next_fired_countdown(double now) {
+  wheel_advance(&countdowns.wheel, countdown_ticks(now));
+  Countdown *c = (Countdown *)wheel_pop_expired(&countdowns.wheel);
+  if (c && c->repeat) {
+    uint64_t next = c->entry.expires + c->period;
+    if (next <= countdowns.wheel.now) // slept through some rounds
+      next = countdowns.wheel.now + c->period;
+    wheel_add(&countdowns.wheel, &c->entry, next);
+  }
+  return c;
+}
+
+double countdown_remaining(const Countdown *c, double now) {
+  if (!c->entry.scheduled)
+    return 0; // done
+  uint64_t t = countdown_ticks(now);
+  return c->entry.expires > t ? (c->entry.expires - t) / 1000.0 : 0;
+}
+
+// Milliseconds until the wheel needs attention, -1 if never.
+int countdown_wake_ms(double now) {
+  uint64_t next = wheel_next(&countdowns.wheel);
+  if (next == UINT64_MAX)
+    return -1;
+  uint64_t t = countdown_ticks(now);
+  uint64_t at = countdowns.wheel.now + next;
+  if (at <= t)
+    return 0;
+  return at - t > INT_MAX ? INT_MAX : (int)(at - t);
+}
+
+// Session-transition chimes, layered over the music on their own reserved
+// channel. They're decoded the first time the device opens (from
+// res/chime_*.wav, or synthesized if there's no file) and kept for as long
+// as the device format stays the same, so playing one at a transition is
+// just queueing a chunk: no file I/O or decoding, and it's audible from the
+// next audio buffer.
+#define CHIME_CHANNEL 0
+#define CHIME_RATE 44100
+
+typedef enum {
+  CHIME_WORK_END,
+  CHIME_BREAK_END,
+  CHIME_LONG_BREAK,
+  CHIME_COUNT
+} ChimeId;
+
+const char *chime_paths[CHIME_COUNT] = {
+    "res/chime_work.wav", "res/chime_break.wav", "res/chime_long_break.wav"};
+// fallback tones in Hz, 0 terminated: up for a break, down back to work
+const float chime_notes[CHIME_COUNT][4] = {
+    {880.0f, 1318.5f}, {1318.5f, 880.0f}, {880.0f, 1108.7f, 1318.5f}};
+
+Mix_Chunk *chimes[CHIME_COUNT];
+
+void put_le(Uint8 *p, Uint32 v, int bytes) {
+  for (int i = 0; i < bytes; i++)
+    p[i] = (v >> (8 * i)) & 0xff;
+}
+
+// Renders the notes as plucked sines into an in-memory 16-bit mono WAV and
+// lets the mixer convert that to the device format.
+Mix_Chunk *synth_chime(const float *notes) {
+  const int note_len = CHIME_RATE * 15 / 100;
+  const int ring_len = CHIME_RATE * 6 / 10;
+  int count = 0;
+  while (count < 4 && notes[count] > 0)
+    count++;
+  if (!count)
+    return NULL;
+  int samples = (count - 1) * note_len + ring_len;
+  Uint32 data = samples * 2;
+  Uint8 *wav = calloc(1, 44 + data);
+  if (!wav)
+    return NULL;
+  memcpy(wav, "RIFF", 4);
+  put_le(wav + 4, 36 + data, 4);
+  memcpy(wav + 8, "WAVEfmt ", 8);
+  put_le(wav + 16, 16, 4);             // fmt chunk size
+  put_le(wav + 20, 1, 2);              // PCM
+  put_le(wav + 22, 1, 2);              // mono
+  put_le(wav + 24, CHIME_RATE, 4);     // sample rate
+  put_le(wav + 28, CHIME_RATE * 2, 4); // byte rate
+  put_le(wav + 32, 2, 2);              // block align
+  put_le(wav + 34, 16, 2);             // bits per sample
+  memcpy(wav + 36, "data", 4);
+  put_le(wav + 40, data, 4);
+
+  for (int i = 0; i < samples; i++) {
+    float v = 0;
+    for (int n = 0; n < count; n++) {
+      int j = i - n * note_len;
+      if (j < 0 || j >= ring_len)
+        continue;
+      float t = (float)j / CHIME_RATE;
+      float attack = fminf(1.0f, t / 0.005f);
+      v += sinf(2.0f * (float)M_PI * notes[n] * t) * attack * expf(-t * 7.0f);
+    }
+    v = fmaxf(-1.0f, fminf(1.0f, v * 0.4f));
+    put_le(wav + 44 + i * 2, (Uint16)(Sint16)(v * 32767.0f), 2);
+  }
+  Mix_Chunk *chunk =
+      Mix_LoadWAV_RW(SDL_RWFromConstMem(wav, (int)(44 + data)), 1);
+  free(wav);
+  return chunk;
+}
+
+void load_chimes(void) {
+  for (int i = 0; i < CHIME_COUNT; i++) {
+    chimes[i] = Mix_LoadWAV(chime_paths[i]);
+    if (!chimes[i])
+      chimes[i] = synth_chime(chime_notes[i]);
+    if (!chimes[i])
+      fprintf(stderr, "Failed to load chime: %s\n", Mix_GetError());
+  }
+}
+
+void free_chimes(void) {
+  Mix_HaltChannel(CHIME_CHANNEL);
+  for (int i = 0; i < CHIME_COUNT; i++) {
+    if (chimes[i])
+      Mix_FreeChunk(chimes[i]);
+    chimes[i] = NULL;
+  }
+}
+
+void play_chime(const Config *cfg, ChimeId id) {
+  int volume = id == CHIME_WORK_END    ? cfg->work_chime
+               : id == CHIME_BREAK_END ? cfg->break_chime
+                                       : cfg->long_break_chime;
+  if (!chimes[id] || volume <= 0)
+    return;
+  Mix_Volume(CHIME_CHANNEL, volume);
+  Mix_PlayChannel(CHIME_CHANNEL, chimes[id], 0);
+}
+
+// The audio device only exists while there's something to hear: it opens on
+// first use and closes when sound is turned off or after AUDIO_IDLE_MS of
+// silence, so a paused or muted timer has no mixer thread at all.
+#define AUDIO_IDLE_MS 60000
+#define AUDIO_RETRY_MS 10000
+
+// Device format the kept chimes and sound cache are in.
+typedef struct {
+  int freq;
+  Uint16 format;
+  int channels;
+} AudioFormat;
+
+AudioFormat kept_audio_format;
+
+bool open_audio(Timer *timer) {
+  if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+    fprintf(stderr, "SDL audio could not initialize! SDL Error: %s\n",
+            SDL_GetError());
+    return false;
+  }
+  // open at the device's own rate and sample format so nothing resamples
+  int freq = MIX_DEFAULT_FREQUENCY;
+  Uint16 format = MIX_DEFAULT_FORMAT;
+#if SDL_VERSION_ATLEAST(2, 24, 0)
+  SDL_AudioSpec native;
+  if (SDL_GetDefaultAudioInfo(NULL, &native, 0) == 0) {
+    freq = native.freq;
+    format = native.format;
+  }
+#endif
+  if (Mix_OpenAudioDevice(freq, format, 2, 2048, NULL,
+                          SDL_AUDIO_ALLOW_FREQUENCY_CHANGE |
+                              SDL_AUDIO_ALLOW_FORMAT_CHANGE) < 0) {
+    fprintf(stderr, "SDL_mixer could not initialize! SDL_mixer Error: %s\n",
+            Mix_GetError());
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    return false;
+  }
+  timer->music = Mix_LoadMUS(SOUNDTRACK_PATH);
+  if (!timer->music) {
+    fprintf(stderr, "Failed to load music: %s\n", Mix_GetError());
+    Mix_CloseAudio();
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    return false;
+  }
+  AudioFormat now = {0};
+  Mix_QuerySpec(&now.freq, &now.format, &now.channels);
+  AudioFormat *kept = &kept_audio_format;
+  if (now.freq != kept->freq || now.format != kept->format ||
+      now.channels != kept->channels) {
+    free_sound_cache();
+    free_chimes();
+    *kept = now;
+    load_chimes();
+  }
+  Mix_ReserveChannels(1);
+  Mix_VolumeMusic(timer->config.volume);
+  Mix_PlayMusic(timer->music, -1);
+  sync_soundtrack(timer, mono_now());
+  start_audio_clock();
+  start_sound_cache(timer->config.audio_cache_mb);
+  timer->audio_open = true;
+  return true;
+}
+
+// Never blocks: if the cache is still decoding, that gets cancelled and
+// this returns false, and a later call does the close.
+bool close_audio(Timer *timer) {
+  if (!timer->audio_open)
+    return true;
+  if (!sound_cache_idle())
+    return false;
+  Mix_HookMusic(NULL, NULL);
+  Mix_HaltChannel(CHIME_CHANNEL);
+  Mix_HaltMusic();
+  Mix_FreeMusic(timer->music);
+  timer->music = NULL;
+  Mix_CloseAudio();
+  stop_audio_clock();
+  SDL_QuitSubSystem(SDL_INIT_AUDIO);
+  timer->audio_open = false;
+  return true;
+}
+
+// At exit: closes the device, waiting out a cancelled decode (that's a
+// read or two), and frees what was kept for the next open.
+void shutdown_audio(Timer *timer) {
+  while (!close_audio(timer))
+    SDL_Delay(1);
+  free_sound_cache();
+  free_chimes();
+}
+
+// Brings the device and the music in line with whether we should be
+// audible right now. Called once per loop iteration.
+void sync_audio(Timer *timer, uint32_t now) {
+  bool audible = timer->config.sound_on && !timer->paused;
+  if (!timer->audio_open) {
+    if (!audible || (int32_t)(now - timer->audio_retry_at) < 0)
+      return;
+    if (!open_audio(timer)) {
+      timer->audio_retry_at = now + AUDIO_RETRY_MS;
+      return;
+    }
+  }
+  if (audible) {
+    if (Mix_PausedMusic())
+      Mix_ResumeMusic();
+    timer->silent_since = 0;
+    return;
+  }
+  if (!Mix_PausedMusic())
+    Mix_PauseMusic();
+  if (!timer->silent_since)
+    timer->silent_since = now ? now : 1;
+  if (!timer->config.sound_on || now - timer->silent_since >= AUDIO_IDLE_MS)
+    close_audio(timer);
+}
+
+// The idle monitor only reports changes, so whether the user is gone is
+// kept and checked every iteration: someone who went idle during a break
+// still gets the next work session paused when it starts.
+void apply_idle(Timer *timer, double now) {
+  if (timer->user_idle && timer->state == w && !timer->paused) {
+    set_paused(timer, true, now);
+    timer->is_away = true;
+    log_event(timer, JOURNAL_AWAY, 1);
+  } else if (!timer->user_idle && timer->is_away) {
+    timer->is_away = false;
+    log_event(timer, JOURNAL_AWAY, 0);
+  }
+}
+
+void reset_timer(Timer *timer, SDL_Window *window) {
+  timer->state = w;
+  timer->sec_remain = timer->config.work_min * 60.0;
+  timer->paused = false;
+  timer->deadline = mono_now() + timer->sec_remain;
+  timer->pause_duration = 0;
+  timer->is_shaking = false;
+  log_event(timer, JOURNAL_START, 0);
+  audio_clock_seek(SEGMENT_WORK, 0);
+}
+
+// Advances the countdown to now and runs the phase transition when it
+// runs out. Returns true if the phase changed.
+bool update_timer(Timer *timer, double now) {
+  if (!timer->paused) {
+    timer->is_shaking = false;
+    timer->pause_duration = 0;
+    timer->sec_remain = timer->deadline - now;
+
+    if (timer->sec_remain <= 0) {
+      log_event(timer, JOURNAL_END, 0);
+      if (timer->state == w) {
+        timer->session_count++;
+        if (timer->session_count % timer->config.sessions_until_long == 0) {
+          timer->state = b;
+          timer->sec_remain = timer->config.long_break_min * 60.0;
+          play_chime(&timer->config, CHIME_LONG_BREAK);
+        } else {
+          timer->state = b;
+          timer->sec_remain = timer->config.break_min * 60.0;
+          play_chime(&timer->config, CHIME_WORK_END);
+        }
+      } else {
+        play_chime(&timer->config, CHIME_BREAK_END);
+        timer->state = w;
+        timer->sec_remain = timer->config.work_min * 60.0;
+      }
+      // chain off the old deadline so nothing accumulates across phases,
+      // unless we're far past it (a suspend that counted)
+      double start = now - timer->deadline < 1.0 ? timer->deadline : now;
+      timer->deadline = start + timer->sec_remain;
+      audio_clock_seek(timer->state == w ? SEGMENT_WORK : SEGMENT_BREAK, 0);
+      log_event(timer, JOURNAL_START, 0);
+      if (!timer->config.auto_start) {
+        set_paused(timer, true, now);
+        log_event(timer, JOURNAL_PAUSE, 1);
+      }
+      return true;
+    }
+  } else {
+    timer->pause_duration = now - timer->paused_at;
+    if (timer->pause_duration > SHAKE_AFTER_SEC && timer->state == w)
+      timer->is_shaking = true;
+  }
+  return false;
+}
+
+void anim_start(Timeline *tl, AnimId id, float from, float to,
+                uint32_t duration, bool loop, Easing ease, int fps,
+                uint32_t now) {
+  Tween *t = &tl->tweens[id];
+  t->active = true;
+  t->loop = loop;
+  t->start = now;
+  t->duration = duration > 0 ? duration : 1;
+  t->from = from;
+  t->to = to;
+  t->ease = ease;
+  t->fps = fps;
+}
+
+void anim_stop(Timeline *tl, AnimId id) { tl->tweens[id].active = false; }
+
+bool anim_active(const Timeline *tl, AnimId id) {
+  return tl->tweens[id].active;
+}
+
+// Current value; a finished one-shot tween holds its end value.
+float anim_value(const Timeline *tl, AnimId id, uint32_t now) {
+  const Tween *t = &tl->tweens[id];
+  float p = (now - t->start) / (float)t->duration;
+  if (t->loop)
+    p -= floorf(p);
+  else if (p > 1.0f)
+    p = 1.0f;
+
+  float e = p;
+  switch (t->ease) {
+  case EASE_LINEAR:
+    break;
+  case EASE_OUT_CUBIC:
+    e = 1.0f - (1.0f - p) * (1.0f - p) * (1.0f - p);
+    break;
+  case EASE_WAVE:
+    e = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * p);
+    break;
+  }
+  return t->from + (t->to - t->from) * e;
+}
+
+// Retires one-shot tweens that have reached their end. Call after their
+// final value has been applied.
+void anim_update(Timeline *tl, uint32_t now) {
+  for (int i = 0; i < ANIM_COUNT; i++) {
+    Tween *t = &tl->tweens[i];
+    if (t->active && !t->loop && now - t->start >= t->duration)
+      t->active = false;
+  }
+}
+
+// ms until some active animation wants its next frame, -1 if none is active
+int anim_next_frame_ms(const Timeline *tl, uint32_t now) {
+  int next = -1;
+  for (int i = 0; i < ANIM_COUNT; i++) {
+    const Tween *t = &tl->tweens[i];
+    if (!t->active)
+      continue;
+    int ms = 1000 / t->fps;
+    if (!t->loop) {
+      // land the last frame exactly on the end value
+      int left = (int)(t->duration - (now - t->start));
+      if (left < ms)
+        ms = left < 0 ? 0 : left;
+    }
+    if (next < 0 || ms < next)
+      next = ms;
+  }
+  return next;
+}
+
+// Starts/stops the state-driven animations to match the timer.
+void sync_animations(Timer *timer, uint32_t now) {
+  Timeline *tl = &timer->anim;
+  if (timer->paused && !anim_active(tl, ANIM_PULSE))
+    anim_start(tl, ANIM_PULSE, 1.0f, 0.4f, 1257, true, EASE_WAVE, 30, now);
+  else if (!timer->paused)
+    anim_stop(tl, ANIM_PULSE);
+
+  if (timer->is_shaking && !anim_active(tl, ANIM_SHAKE_X)) {
+    // two incommensurate periods so it reads as jitter, not a circle
+    anim_start(tl, ANIM_SHAKE_X, -2.0f, 2.0f, 90, true, EASE_WAVE, 30, now);
+    anim_start(tl, ANIM_SHAKE_Y, -2.0f, 2.0f, 130, true, EASE_WAVE, 30, now);
+  } else if (!timer->is_shaking) {
+    anim_stop(tl, ANIM_SHAKE_X);
+    anim_stop(tl, ANIM_SHAKE_Y);
+  }
+}
+
+// Re-reads pomo.cfg and applies only what actually changed.
+void reload_config(Timer *timer, SDL_Window *window) {
+  // a change of ours still on its way to the file wins over the file
+  if (config_save_pending() || config_matches_persisted())
+    return;
+  Config old = timer->config;
+  Config *cfg = &timer->config;
+  load_config(cfg);
+  char before[512], after[512];
+  format_config(&old, before, sizeof(before));
+  format_config(cfg, after, sizeof(after));
+  if (strcmp(before, after) == 0)
+    return;
+  timer->settings_view.dirty = true;
+
+  // a new length for the phase that's running restarts it, the others
+  // just take effect the next time they start
+  Phase phase = timer_phase(timer);
+  if ((phase == PHASE_WORK && old.work_min != cfg->work_min) ||
+      (phase == PHASE_BREAK && old.break_min != cfg->break_min) ||
+      (phase == PHASE_LONG_BREAK &&
+       old.long_break_min != cfg->long_break_min)) {
+    restart_phase(timer, mono_now());
+  }
+  if (old.volume != cfg->volume && timer->audio_open)
+    Mix_VolumeMusic(cfg->volume);
+  if (old.x != cfg->x || old.y != cfg->y) {
+    int wx, wy;
+    SDL_GetWindowPosition(window, &wx, &wy);
+    if (wx != cfg->x || wy != cfg->y)
+      SDL_SetWindowPosition(window, cfg->x, cfg->y);
+  }
+}
+
+// How long the main loop may sleep before something on screen (or the audio
+// sync) needs attention. -1 means nothing is due, wait for the next event.
+int next_wake_ms(const Timer *timer, bool visible, uint32_t now) {
+  int wait = -1;
+  if (!timer->paused) {
+    // the displayed value is ceil(sec_remain), so it changes as soon as
+    // sec_remain drops below the current whole second. wake just after that.
+    double remain = timer->deadline - mono_now();
+    double frac = remain - floor(remain);
+    wait = (int)ceil((frac + 0.001) * 1000.0);
+  } else if (timer->state == w && !timer->is_shaking) {
+    double paused_for = mono_now() - timer->paused_at;
+    wait = (int)ceil((SHAKE_AFTER_SEC - paused_for) * 1000.0);
+    if (wait < 0)
+      wait = 0;
+  }
+  int due = countdown_wake_ms(mono_now());
+  if (due >= 0 && (wait < 0 || due < wait))
+    wait = due;
+  if (visible && timer->view > 0) {
+    // the shown countdown ticks over on whole seconds too
+    double remain =
+        countdown_remaining(&countdowns.items[timer->view - 1], mono_now());
+    if (remain > 0) {
+      int tick = (int)ceil((remain - floor(remain) + 0.001) * 1000.0);
+      if (wait < 0 || tick < wait)
+        wait = tick;
+    }
+  }
+  if (timer->audio_open && timer->silent_since) {
+    // wake up to close the idle audio device
+    int idle = (int)(timer->silent_since + AUDIO_IDLE_MS - now);
+    if (idle < 0)
+      idle = 0;
+    if (wait < 0 || idle < wait)
+      wait = idle;
+  }
+  if (visible) {
+    int frame = anim_next_frame_ms(&timer->anim, now);
+    if (frame >= 0 && (wait < 0 || frame < wait))
+      wait = frame;
+  }
+  return wait;
+}
+
+void open_settings_window(Timer *timer, TTF_Font *font) {
+  if (timer->settings_win)
+    return;
+
+  timer->settings_win =
+      SDL_CreateWindow("Configuration", SDL_WINDOWPOS_CENTERED,
+                       SDL_WINDOWPOS_CENTERED, 320, 420, SDL_WINDOW_SHOWN);
+  timer->settings_ren =
+      SDL_CreateRenderer(timer->settings_win, -1, SDL_RENDERER_ACCELERATED);
+  timer->selected_setting = 0;
+  memset(&timer->settings_view, 0, sizeof(timer->settings_view));
+  timer->settings_view.dirty = true;
+}
+
+void close_settings_window(Timer *timer) {
+  if (!timer->settings_win)
+    return;
+  SettingsView *view = &timer->settings_view;
+  if (view->title)
+    SDL_DestroyTexture(view->title);
+  for (int i = 0; i < NUM_SETTINGS; i++) {
+    if (view->rows[i].tex)
+      SDL_DestroyTexture(view->rows[i].tex);
+  }
+  memset(view, 0, sizeof(*view));
+  SDL_DestroyRenderer(timer->settings_ren);
+  SDL_DestroyWindow(timer->settings_win);
+  timer->settings_win = NULL;
+  timer->settings_ren = NULL;
+  save_config(&timer->config);
+}
+
+void format_setting_row(const Config *cfg, int i, char *buf, size_t len) {
+  const char *settings_names[] = {"Work Duration (min)",
+                                  "Break Duration (min)",
+                                  "Long Break Duration (min)",
+                                  "Sessions until Long Break",
+                                  "Sound Enabled",
+                                  "Auto-start Next Session",
+                                  "Opacity (Unused in C)",
+                                  "Volume (0-128)",
+                                  "Focus Idle Thr. (s)"};
+
+  switch (i) {
+  case 0:
+    snprintf(buf, len, "%s: %d", settings_names[i], cfg->work_min);
+    break;
+  case 1:
+    snprintf(buf, len, "%s: %d", settings_names[i], cfg->break_min);
+    break;
+  case 2:
+    snprintf(buf, len, "%s: %d", settings_names[i], cfg->long_break_min);
+    break;
+  case 3:
+    snprintf(buf, len, "%s: %d", settings_names[i], cfg->sessions_until_long);
+    break;
+  case 4:
+    snprintf(buf, len, "%s: %s", settings_names[i],
+             cfg->sound_on ? "ON" : "OFF");
+    break;
+  case 5:
+    snprintf(buf, len, "%s: %s", settings_names[i],
+             cfg->auto_start ? "YES" : "NO");
+    break;
+  case 6:
+    snprintf(buf, len, "%s: %d%%", settings_names[i], cfg->opacity);
+    break;
+  case 7:
+    snprintf(buf, len, "%s: %d", settings_names[i], cfg->volume);
+    break;
+  case 8:
+    snprintf(buf, len, "%s: %d", settings_names[i], cfg->focus_threshold);
+    break;
+  }
+}
+
+SDL_Texture *render_text_texture(SDL_Renderer *ren, TTF_Font *font,
+                                 const char *text, SDL_Color color, int *w,
+                                 int *h) {
+  SDL_Surface *s = TTF_RenderText_Blended(font, text, color);
+  if (!s)
+    return NULL;
+  SDL_Texture *t = SDL_CreateTextureFromSurface(ren, s);
+  *w = s->w;
+  *h = s->h;
+  SDL_FreeSurface(s);
+  return t;
+}
+
+void render_settings(Timer *timer, TTF_Font *font) {
+  if (!timer->settings_win || !timer->settings_view.dirty)
+    return;
+  SettingsView *view = &timer->settings_view;
+
+  SDL_SetRenderDrawColor(timer->settings_ren, 20, 22, 28, 255);
+  SDL_RenderClear(timer->settings_ren);
+
+  SDL_Color white = {255, 255, 255, 255};
+  SDL_Color gray = {139, 148, 158, 255};
+  SDL_Color highlight = {56, 139, 253, 40}; // Blue-ish highlight
+  char buf[128];
+
+  // Title (fixed at top)
+  if (!view->title)
+    view->title = render_text_texture(timer->settings_ren, font,
+                                      "Configuration", white, &view->title_w,
+                                      &view->title_h);
+  if (view->title) {
+    SDL_Rect title_r = {20, 10, view->title_w, view->title_h};
+    SDL_RenderCopy(timer->settings_ren, view->title, NULL, &title_r);
+  }
+
+  int num_settings = NUM_SETTINGS;
+  int start_y = 50;
+  int row_h = 35; // Match Cocoa row height
+  int win_h = 420;
+  int win_w = 320;
+  int max_visible_h = win_h - start_y;
+  int total_h = num_settings * row_h;
+
+  // Clamp scroll
+  int max_scroll = fmax(0, total_h - max_visible_h + 20); // +20 padding
+  timer->settings_scroll_y =
+      fmin(max_scroll, fmax(0, timer->settings_scroll_y));
+
+  SDL_Rect clip_rect = {0, start_y, win_w, max_visible_h};
+  SDL_RenderSetClipRect(timer->settings_ren, &clip_rect);
+
+  for (int i = 0; i < num_settings; i++) {
+    int y = start_y + i * row_h - timer->settings_scroll_y;
+
+    // Cull invisible items
+    if (y + row_h < start_y || y > win_h)
+      continue;
+
+    SDL_Rect row_rect = {10, y + 2, win_w - 20, row_h - 4};
+    bool selected = timer->selected_setting == i;
+
+    if (selected) {
+      SDL_SetRenderDrawColor(timer->settings_ren, highlight.r, highlight.g,
+                             highlight.b, highlight.a);
+      SDL_RenderFillRect(timer->settings_ren, &row_rect);
+    }
+
+    SettingsRow *row = &view->rows[i];
+    format_setting_row(&timer->config, i, buf, sizeof(buf));
+    if (!row->tex || row->selected != selected || strcmp(row->text, buf)) {
+      if (row->tex)
+        SDL_DestroyTexture(row->tex);
+      row->tex = render_text_texture(timer->settings_ren, font, buf,
+                                     selected ? white : gray, &row->w, &row->h);
+      strcpy(row->text, buf);
+      row->selected = selected;
+    }
+    if (row->tex) {
+      SDL_Rect r = {20, y + (row_h - row->h) / 2, row->w,
+                    row->h}; // Center vertically
+      SDL_RenderCopy(timer->settings_ren, row->tex, NULL, &r);
+    }
+  }
+
+  SDL_RenderSetClipRect(timer->settings_ren, NULL);
+
+  // Scrollbar if needed
+  if (total_h > max_visible_h) {
+    int bar_h = (float)max_visible_h / total_h * max_visible_h;
+    int bar_y = start_y + ((float)timer->settings_scroll_y / max_scroll) *
+                              (max_visible_h - bar_h);
+    SDL_SetRenderDrawColor(timer->settings_ren, 80, 80, 90, 200);
+    SDL_Rect scroll_rect = {390, bar_y, 6, bar_h};
+    SDL_RenderFillRect(timer->settings_ren, &scroll_rect);
+  }
+
+  SDL_RenderPresent(timer->settings_ren);
+  view->dirty = false;
+}
+
+void open_streak_window(Timer *timer, TTF_Font *font) {
+  if (timer->streak_win)
+    return;
+  timer->streak_win =
+      SDL_CreateWindow("Streak Counter", SDL_WINDOWPOS_CENTERED,
+                       SDL_WINDOWPOS_CENTERED, 750, 250, SDL_WINDOW_SHOWN);
+  timer->streak_ren =
+      SDL_CreateRenderer(timer->streak_win, -1,
+                         SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
+  if (!timer->streak_ren) // software fallback, still has targets
+    timer->streak_ren = SDL_CreateRenderer(timer->streak_win, -1, 0);
+
+  StreakView *view = &timer->streak_view;
+  memset(view, 0, sizeof(*view));
+  if (timer->streak_ren && SDL_RenderTargetSupported(timer->streak_ren))
+    view->target =
+        SDL_CreateTexture(timer->streak_ren, SDL_PIXELFORMAT_RGBA8888,
+                          SDL_TEXTUREACCESS_TARGET, 750, 250);
+
+  SDL_Color gray = {139, 148, 158, 255};
+  const char *days[] = {"", "Mon", "", "Wed", "", "Fri", ""};
+  const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                          "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+  int tw, th;
+  for (int i = 0; i < 7; i++) {
+    if (strlen(days[i]) > 0)
+      view->days[i] = render_text_texture(timer->streak_ren, font, days[i],
+                                          gray, &tw, &th);
+  }
+  for (int i = 0; i < 12; i++)
+    view->months[i] = render_text_texture(timer->streak_ren, font, months[i],
+                                          gray, &tw, &th);
+  view->less =
+      render_text_texture(timer->streak_ren, font, "Less", gray, &tw, &th);
+  view->more =
+      render_text_texture(timer->streak_ren, font, "More", gray, &tw, &th);
+  view->stale = true;
+  view->dirty = true;
+}
+
+void close_streak_window(Timer *timer) {
+  if (!timer->streak_win)
+    return;
+  StreakView *view = &timer->streak_view;
+  SDL_Texture **texs[] = {&view->target, &view->less, &view->more};
+  for (int i = 0; i < 3; i++) {
+    if (*texs[i])
+      SDL_DestroyTexture(*texs[i]);
+  }
+  for (int i = 0; i < 7; i++) {
+    if (view->days[i])
+      SDL_DestroyTexture(view->days[i]);
+  }
+  for (int i = 0; i < 12; i++) {
+    if (view->months[i])
+      SDL_DestroyTexture(view->months[i]);
+  }
+  memset(view, 0, sizeof(*view));
+  SDL_DestroyRenderer(timer->streak_ren);
+  SDL_DestroyWindow(timer->streak_win);
+  timer->streak_win = NULL;
+  timer->streak_ren = NULL;
+}
+
+// right/left align is done by the caller, (x, y) is the top left corner
+void copy_text_texture(SDL_Renderer *ren, SDL_Texture *tex, int x, int y) {
+  int tw, th;
+  if (!tex || SDL_QueryTexture(tex, NULL, NULL, &tw, &th) != 0)
+    return;
+  SDL_Rect r = {x, y, tw, th};
+  SDL_RenderCopy(ren, tex, NULL, &r);
+}
+
+int streak_bucket(int sessions) {
+  if (sessions <= 0)
+    return 0;
+  if (sessions < 2)
+    return 1;
+  if (sessions < 4)
+    return 2;
+  if (sessions < 6)
+    return 3;
+  return 4;
+}
+
+// Draws the full streak view into the current render target.
+void draw_streak_contents(Timer *timer, TTF_Font *font,
+                          const struct tm *t_now) {
+  SDL_Renderer *ren = timer->streak_ren;
+  StreakView *view = &timer->streak_view;
+  // GitHub Dark Dimmed background
+  SDL_SetRenderDrawColor(ren, 22, 27, 34, 255);
+  SDL_RenderClear(ren);
+
+  SDL_Color white = {255, 255, 255, 255};
+  SDL_Color gray = {139, 148, 158, 255};
+  char buf[256];
+  int tw, th;
+
+  // Header stats, only re-rendered when the view is rebuilt
+  const char *fmt[] = {"Daily Sessions: %d", "Consecutive Days: %d"};
+  int vals[] = {timer->streak.daily_sessions, timer->streak.consecutive_days};
+  int xs[] = {30, 200, 400};
+  for (int i = 0; i < 3; i++) {
+    if (i < 2)
+      sprintf(buf, fmt[i], vals[i]);
+    else {
+      char date[11];
+      format_day(timer->streak.last_day, date);
+      sprintf(buf, "Last Active: %s", date);
+    }
+    SDL_Texture *t =
+        render_text_texture(ren, font, buf, i < 2 ? white : gray, &tw, &th);
+    if (t) {
+      copy_text_texture(ren, t, xs[i], 20);
+      SDL_DestroyTexture(t);
+    }
+  }
+
+  // GitHub Graph
+  int start_x = 50;
+  int start_y = 80;
+  int sq_size = 10;
+  int gap = 3;
+
+  // Colors (GitHub Dark)
+  // 0: #161b22, 1: #0e4429, 2: #006d32, 3: #26a641, 4: #39d353
+  SDL_Color colors[] = {{45, 51, 59, 255}, // Empty cell
+                        {14, 68, 41, 255},
+                        {0, 109, 50, 255},
+                        {38, 166, 65, 255},
+                        {57, 211, 83, 255}};
+
+  // Day labels
+  for (int i = 0; i < 7; i++)
+    copy_text_texture(ren, view->days[i], 10,
+                      start_y + i * (sq_size + gap) - 2);
+
+  // We are showing 52 weeks ending today.
+  int today = days_from_civil(t_now->tm_year + 1900, t_now->tm_mon + 1,
+                              t_now->tm_mday);
+
+  // Month labels where the month changes between week columns
+  int prev_mon = -1;
+  for (int w = 0; w < 52; w++) {
+    // first day (Sunday) of this week column
+    int y, m, d;
+    civil_from_days(today - ((51 - w) * 7 + t_now->tm_wday), &y, &m, &d);
+    if (w == 0 || m - 1 != prev_mon) {
+      copy_text_texture(ren, view->months[m - 1], start_x + w * (sq_size + gap),
+                        start_y - 20);
+      prev_mon = m - 1;
+    }
+  }
+
+  // Grid + legend, batched into one fill call per colour
+  int leg_x = start_x + 52 * (sq_size + gap) - 100;
+  int leg_y = start_y + 7 * (sq_size + gap) + 15;
+  SDL_Rect cells[5][52 * 7 + 1];
+  int counts[5] = {0};
+  for (int w = 0; w < 52; w++) {
+    for (int d = 0; d < 7; d++) {
+      int days_ago = (51 - w) * 7 + (t_now->tm_wday - d);
+      int k = days_ago >= 0
+                  ? streak_bucket(history_get(&timer->streak.history,
+                                              today - days_ago))
+                  : 0;
+      SDL_Rect rect = {start_x + w * (sq_size + gap),
+                       start_y + d * (sq_size + gap), sq_size, sq_size};
+      cells[k][counts[k]++] = rect;
+    }
+  }
+  for (int i = 0; i < 5; i++) {
+    SDL_Rect lrect = {leg_x + i * (sq_size + gap), leg_y, sq_size, sq_size};
+    cells[i][counts[i]++] = lrect;
+    SDL_SetRenderDrawColor(ren, colors[i].r, colors[i].g, colors[i].b,
+                           colors[i].a);
+    SDL_RenderFillRects(ren, cells[i], counts[i]);
+  }
+
+  if (view->less && SDL_QueryTexture(view->less, NULL, NULL, &tw, &th) == 0)
+    copy_text_texture(ren, view->less, leg_x - tw - 5, leg_y - 2);
+  copy_text_texture(ren, view->more, leg_x + 5 * (sq_size + gap) + 5,
+                    leg_y - 2);
+}
+
+void render_streak(Timer *timer, TTF_Font *font) {
+  if (!timer->streak_win)
+    return;
+  StreakView *view = &timer->streak_view;
+  time_t now = wall_now();
+  if (view->built_revision != timer->streak.revision ||
+      now >= view->next_midnight)
+    view->stale = true;
+  if (!view->stale && !view->dirty)
+    return;
+
+  struct tm t_now = *localtime(&now);
+  if (view->target) {
+    if (view->stale) {
+      SDL_SetRenderTarget(timer->streak_ren, view->target);
+      draw_streak_contents(timer, font, &t_now);
+      SDL_SetRenderTarget(timer->streak_ren, NULL);
+    }
+    SDL_RenderCopy(timer->streak_ren, view->target, NULL, NULL);
+  } else {
+    draw_streak_contents(timer, font, &t_now);
+  }
+  SDL_RenderPresent(timer->streak_ren);
+
+  struct tm midnight = t_now;
+  midnight.tm_hour = midnight.tm_min = midnight.tm_sec = 0;
+  midnight.tm_mday++;
+  midnight.tm_isdst = -1;
+  view->next_midnight = mktime(&midnight);
+  view->built_revision = timer->streak.revision;
+  view->stale = false;
+  view->dirty = false;
+}
+
+void snap_to_corner(SDL_Window *window) {
+  int displayIndex = SDL_GetWindowDisplayIndex(window);
+  if (displayIndex < 0)
+    return;
+
+  SDL_Rect usableBounds;
+  if (SDL_GetDisplayUsableBounds(displayIndex, &usableBounds) != 0)
+    return;
+
+  int wx, wy, ww_local, wh_local;
+  SDL_GetWindowPosition(window, &wx, &wy);
+  SDL_GetWindowSize(window, &ww_local, &wh_local);
+
+  // 4 corners of the usable bounds
+  SDL_Point corners[] = {
+      {usableBounds.x, usableBounds.y},                             // Top-Left
+      {usableBounds.x + usableBounds.w - ww_local, usableBounds.y}, // Top-Right
+      {usableBounds.x,
+       usableBounds.y + usableBounds.h - wh_local}, // Bottom-Left
+      {usableBounds.x + usableBounds.w - ww_local,
+       usableBounds.y + usableBounds.h - wh_local} // Bottom-Right
+  };
+
+  SDL_Point nearestCorner = corners[0];
+  long min_dist_sq = 2000000000; // Large enough
+
+  for (int i = 0; i < 4; i++) {
+    long dx = (long)wx - corners[i].x;
+    long dy = (long)wy - corners[i].y;
+    long dist_sq = dx * dx + dy * dy;
+    if (dist_sq < min_dist_sq) {
+      min_dist_sq = dist_sq;
+      nearestCorner = corners[i];
+    }
+  }
+
+  // Glide there like Cocoa's animate:YES; the main loop moves the window
+  // along the tween. Without the timer there's nothing to drive it, so jump.
+  void *data = SDL_GetWindowData(window, "timer");
+  if (!data) {
+    SDL_SetWindowPosition(window, nearestCorner.x, nearestCorner.y);
+    return;
+  }
+
+  Timer *timer = (Timer *)data;
+  uint32_t now = SDL_GetTicks();
+  if (wx != nearestCorner.x || wy != nearestCorner.y) {
+    anim_start(&timer->anim, ANIM_SNAP_X, wx, nearestCorner.x, 200, false,
+               EASE_OUT_CUBIC, 60, now);
+    anim_start(&timer->anim, ANIM_SNAP_Y, wy, nearestCorner.y, 200, false,
+               EASE_OUT_CUBIC, 60, now);
+  }
+
+  // Save new position
+  timer->config.x = nearestCorner.x;
+  timer->config.y = nearestCorner.y;
+  save_config(&timer->config);
+}
+
+// time txt + label for the main window
+void format_main_text(const Timer *timer, char spiderman[16], char label[64]) {
+  if (timer->view > 0) {
+    const Countdown *c = &countdowns.items[timer->view - 1];
+    int secs = (int)ceil(countdown_remaining(c, mono_now()));
+    sprintf(spiderman, "%02d:%02d", secs / 60, secs % 60);
+    if (!c->entry.scheduled)
+      snprintf(label, 64, "%s - DONE", c->name);
+    else if (c->repeat)
+      snprintf(label, 64, "%s (every %d min)", c->name,
+               (int)(c->period / 60000));
+    else
+      snprintf(label, 64, "%s", c->name);
+    return;
+  }
+  int display_secs = (int)ceil(timer->sec_remain);
+  sprintf(spiderman, "%02d:%02d", display_secs / 60, display_secs % 60);
+
+  if (timer->is_away) {
+    strcpy(label, "AWAY? FOCUS!");
+  } else if (timer->paused) {
+    strcpy(label, "PAUSED");
+  } else if (timer->state == w) {
+    sprintf(label, "GOOD BOY :3 Session #%d", timer->session_count + 1);
+  } else {
+    strcpy(label, "BREAK! ENJOY");
+  }
+}
+
+// Draws one frame of the main window into the current GL context. Kept free
+// of event loop state so the render bench can drive it directly.
+void render_main_view(const Timer *timer, const RingGeometry *geo,
+                      const GlyphAtlas *atlas, const char *spiderman,
+                      const char *label, uint32_t now) {
+  glClearColor(0.10f, 0.12f, 0.18f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  // paused too long: shake the contents instead of the OS window
+  glPushMatrix();
+  if (anim_active(&timer->anim, ANIM_SHAKE_X))
+    glTranslatef(roundf(anim_value(&timer->anim, ANIM_SHAKE_X, now)),
+                 roundf(anim_value(&timer->anim, ANIM_SHAKE_Y, now)), 0);
+
+  // progress
+  double total = (timer->state == w) ? timer->config.work_min * 60.0
+                                     : timer->config.break_min * 60.0;
+  float progress = (float)(timer->sec_remain / total);
+  float ring_r = (timer->state == w) ? 1.0f : 0.4f;
+  float ring_g = (timer->state == w) ? 0.45f : 0.85f;
+  float ring_b = (timer->state == w) ? 0.45f : 1.0f;
+  if (timer->view > 0) {
+    const Countdown *c = &countdowns.items[timer->view - 1];
+    progress = (float)(countdown_remaining(c, mono_now()) * 1000.0 / c->period);
+    ring_r = 1.0f;
+    ring_g = 0.8f;
+    ring_b = 0.3f;
+  }
+  if (progress < 0)
+    progress = 0;
+  draw_ring_geometry(geo, progress, ring_r, ring_g, ring_b);
+
+  SDL_Color white = {255, 255, 255, 255};
+
+  float alpha = 1.0f;
+  if (anim_active(&timer->anim, ANIM_PULSE)) {
+    alpha = anim_value(&timer->anim, ANIM_PULSE, now);
+  }
+  draw_atlas_text(atlas, &atlas->large, spiderman, ww / 2.0f, wh / 2.0f - 10,
+                  true, white, alpha);
+
+  SDL_Color gray = {191, 199, 230, 230};
+  draw_atlas_text(atlas, &atlas->small, label, ww / 2.0f, wh / 2.0f + 25, true,
+                  gray, 1.0f);
+  glPopMatrix();
+}
+
+typedef struct {
+  const char *name;
+  double *samples; // microseconds per frame
+  int count;
+} BenchSeries;
+
+double bench_now_us(void) {
+  return SDL_GetPerformanceCounter() * 1e6 / SDL_GetPerformanceFrequency();
+}
+
+int compare_doubles(const void *a, const void *b) {
+  double da = *(const double *)a, db = *(const double *)b;
+  return (da > db) - (da < db);
+}
+
+void bench_report(BenchSeries *bs) {
+  if (bs->count == 0)
+    return;
+  double sum = 0;
+  for (int i = 0; i < bs->count; i++)
+    sum += bs->samples[i];
+  qsort(bs->samples, bs->count, sizeof(double), compare_doubles);
+  printf("%-16s %10.1f %10.1f %10.1f %10.1f\n", bs->name, sum / bs->count,
+         bs->samples[bs->count / 2], bs->samples[(int)(bs->count * 0.99)],
+         bs->samples[bs->count - 1]);
+}
+
+// --bench-render N: draw N frames of every view offscreen and report frame
+// times. Meant to be run under SDL's offscreen driver with software GL, see
+// `make bench-render`.
+void run_render_bench(Timer *timer, SDL_Window *window,
+                      const RingGeometry *geo, const GlyphAtlas *atlas,
+                      TTF_Font *font_medium, TTF_Font *font_small,
+                      int frames) {
+  SDL_GL_SetSwapInterval(0);
+  Config saved_config = timer->config; // closing settings saves it
+
+  // a full year of synthetic history so the heatmap has every bucket
+  int today = local_day(wall_now());
+  history_free(&timer->streak.history);
+  for (int i = 0; i < 365; i++)
+    history_set(&timer->streak.history, today - i, (i * 7) % 9);
+  timer->streak.revision++;
+
+  open_settings_window(timer, font_medium);
+  open_streak_window(timer, font_small);
+
+  BenchSeries series[] = {{"main"}, {"settings"}, {"streak-rebuild"},
+                          {"streak-present"}};
+  int num_series = sizeof(series) / sizeof(series[0]);
+  for (int i = 0; i < num_series; i++)
+    series[i].samples = malloc(frames * sizeof(double));
+
+  for (int i = 0; i < frames; i++) {
+    // sweep through both phases, paused and running, all progress values
+    timer->state = (i / 1000) % 2 ? b : w;
+    timer->paused = (i / 250) % 4 == 3;
+    double total = (timer->state == w) ? timer->config.work_min * 60.0
+                                       : timer->config.break_min * 60.0;
+    timer->sec_remain = total - fmod(i * 7.3, total);
+
+    sync_animations(timer, i * 16);
+
+    char spiderman[16], label[64];
+    double t0 = bench_now_us();
+    format_main_text(timer, spiderman, label);
+    render_main_view(timer, geo, atlas, spiderman, label, i * 16);
+    SDL_GL_SwapWindow(window);
+    glFinish();
+    double t1 = bench_now_us();
+
+    // settings after an arrow key: selection moves, value changes
+    timer->selected_setting = i % NUM_SETTINGS;
+    timer->config.volume = (i * 8) % 129;
+    timer->settings_view.dirty = true;
+    render_settings(timer, font_medium);
+    double t2 = bench_now_us();
+
+    timer->streak_view.stale = true;
+    render_streak(timer, font_small);
+    double t3 = bench_now_us();
+
+    timer->streak_view.dirty = true;
+    render_streak(timer, font_small);
+    double t4 = bench_now_us();
+
+    series[0].samples[series[0].count++] = t1 - t0;
+    series[1].samples[series[1].count++] = t2 - t1;
+    series[2].samples[series[2].count++] = t3 - t2;
+    series[3].samples[series[3].count++] = t4 - t3;
+  }
+
+  printf("bench-render: %d frames, video=%s, GL=%s, ring=%s\n", frames,
+         SDL_GetCurrentVideoDriver(), (const char *)glGetString(GL_RENDERER),
+         geo->program ? "shader" : "fixed-function");
+  printf("%-16s %10s %10s %10s %10s  (us)\n", "path", "mean", "p50", "p99",
+         "max");
+  for (int i = 0; i < num_series; i++) {
+    bench_report(&series[i]);
+    free(series[i].samples);
+  }
+
+  timer->config = saved_config;
+  close_settings_window(timer);
+  close_streak_window(timer);
+}
+
+// Status page for status bars, see pomo_status.h. Publishing is a handful
+// of stores into the mapping, so it's done every loop iteration.
+PomoStatus *status_page;
+char status_path[512];
+
+void open_status_page(void) {
+  pomo_status_path(status_path, sizeof(status_path));
+  int fd = open(status_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0 || ftruncate(fd, sizeof(PomoStatus)) != 0) {
+    fprintf(stderr, "Failed to create %s\n", status_path);
+    if (fd >= 0)
+      close(fd);
+    return;
+  }
+  void *p = mmap(NULL, sizeof(PomoStatus), PROT_READ | PROT_WRITE, MAP_SHARED,
+                 fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "Failed to map %s\n", status_path);
+    return;
+  }
+  status_page = p;
+  // readers check the magic, so it goes in last
+  atomic_store(&status_page->seq, 0);
+  status_page->version = POMO_STATUS_VERSION;
+  status_page->pid = getpid();
+  status_page->flags = 0;
+  atomic_thread_fence(memory_order_release);
+  status_page->magic = POMO_STATUS_MAGIC;
+}
+
+void publish_status(const Timer *timer, double now) {
+  PomoStatus *st = status_page;
+  if (!st)
+    return;
+  uint32_t seq = atomic_load_explicit(&st->seq, memory_order_relaxed);
+  atomic_store_explicit(&st->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  const Streak *streak = &timer->streak;
+  st->phase = timer_phase(timer);
+  st->flags = (timer->paused ? POMO_STATUS_PAUSED : 0) |
+              (timer->is_away ? POMO_STATUS_AWAY : 0);
+  st->sec_remain = timer->paused ? timer->sec_remain : timer->deadline - now;
+  st->updated_ns = pomo_status_now_ns();
+  st->session_count = timer->session_count;
+  st->daily_sessions =
+      streak->last_day == local_day(wall_now()) ? streak->daily_sessions : 0;
+  st->consecutive_days = streak->consecutive_days;
+
+  atomic_store_explicit(&st->seq, seq + 2, memory_order_release);
+}
+
+// Readers that still have it mapped see EXITED; new ones find no file.
+void close_status_page(void) {
+  if (!status_page)
+    return;
+  uint32_t seq = atomic_load(&status_page->seq);
+  atomic_store(&status_page->seq, seq + 1);
+  status_page->flags |= POMO_STATUS_EXITED;
+  atomic_store(&status_page->seq, seq + 2);
+  munmap(status_page, sizeof(PomoStatus));
+  status_page = NULL;
+  unlink(status_path);
+}
+
+// --status: one line for scripts, e.g. "work 24:13 running 3".
+int print_status(void) {
+  static const char *phases[] = {"work", "break", "long_break"};
+  PomoStatusReader r;
+  PomoStatus st;
+  if (!pomo_status_open(&r) || !pomo_status_read(&r, &st)) {
+    printf("not running\n");
+    return 1;
+  }
+  int remain = (int)ceil(pomo_status_remaining(&st));
+  printf("%s %02d:%02d %s %d\n", st.phase < 3 ? phases[st.phase] : "?",
+         remain / 60, remain % 60,
+         st.flags & POMO_STATUS_AWAY     ? "away"
+         : st.flags & POMO_STATUS_PAUSED ? "paused"
+                                         : "running",
+         st.daily_sessions);
+  pomo_status_close(&r);
+  return 0;
+}
+
+// --daemon: the same timer engine with no window, GL, fonts or audio,
+// driven over a Unix socket. One command per line:
+//
+//   start | pause | reset | status | subscribe
+//
+// Every command is answered with a status line, and subscribed clients get
+// one pushed whenever the state changes, so nobody has to poll:
+//
+//   status <work|break|long_break> <running|paused> <secs left> <sessions>
+#define DAEMON_SOCKET "pomo.sock"
+#define MAX_CLIENTS 16
+
+typedef struct {
+  int fd;
+  char buf[256];
+  int len;
+  bool subscribed;
+} Client;
+
+volatile sig_atomic_t daemon_quit;
+
+void daemon_signal(int sig) {
+  (void)sig;
+  daemon_quit = 1;
+}
+
+void format_status(const Timer *timer, double now, char *buf, size_t len) {
+  static const char *phases[] = {"work", "break", "long_break"};
+  double remain = timer->paused ? timer->sec_remain : timer->deadline - now;
+  snprintf(buf, len, "status %s %s %.0f %d\n", phases[timer_phase(timer)],
+           timer->paused ? "paused" : "running", ceil(fmax(0, remain)),
+           timer->session_count);
+}
+
+void drop_client(Client *c) {
+  close(c->fd);
+  c->fd = -1;
+}
+
+void send_line(Client *c, const char *line) {
+  size_t len = strlen(line);
+  // status lines are tiny and the socket doesn't block, so a client that
+  // can't take one right now (EAGAIN or a short write) is gone or stuck
+  if (write(c->fd, line, len) != (ssize_t)len)
+    drop_client(c);
+}
+
+// Runs one command line. Returns true if the timer state changed.
+bool daemon_command(Timer *timer, Client *c, const char *cmd, double now) {
+  bool changed = false;
+  if (strcmp(cmd, "start") == 0) {
+    changed = timer->paused;
+    set_paused(timer, false, now);
+  } else if (strcmp(cmd, "pause") == 0) {
+    changed = !timer->paused;
+    set_paused(timer, true, now);
+  } else if (strcmp(cmd, "reset") == 0) {
+    reset_timer(timer, NULL);
+    changed = true;
+  } else if (strcmp(cmd, "subscribe") == 0) {
+    c->subscribed = true;
+  } else if (strcmp(cmd, "status") != 0) {
+    send_line(c, "error unknown command\n");
+    return false;
+  }
+  if (changed && strcmp(cmd, "reset") != 0)
+    log_event(timer, JOURNAL_PAUSE, timer->paused);
+  // subscribers hear about changes from the broadcast instead
+  if (!changed || !c->subscribed) {
+    char line[128];
+    format_status(timer, mono_now(), line, sizeof(line));
+    send_line(c, line);
+  }
+  return changed;
+}
+
+void read_client(Timer *timer, Client *c, double now, bool *changed) {
+  ssize_t n = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+  if (n < 0 && (errno == EAGAIN || errno == EINTR))
+    return;
+  if (n <= 0) {
+    drop_client(c);
+    return;
+  }
+  c->len += n;
+  c->buf[c->len] = 0;
+  char *line = c->buf, *nl;
+  while (c->fd >= 0 && (nl = strchr(line, '\n'))) {
+    *nl = 0;
+    if (nl > line && nl[-1] == '\r')
+      nl[-1] = 0;
+    if (daemon_command(timer, c, line, now))
+      *changed = true;
+    line = nl + 1;
+  }
+  if (c->fd < 0)
+    return;
+  c->len -= line - c->buf;
+  memmove(c->buf, line, c->len);
+  if (c->len == sizeof(c->buf) - 1)
+    drop_client(c); // no newline in sight
+}
 
-    SDL_Rect row_rect = {10, y + 2, win_w - 20, row_h - 4};
+int run_daemon(const char *path) {
+  struct sockaddr_un addr = {0};
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    return 1;
+  }
+  strcpy(addr.sun_path, path);
 
-    if (timer->selected_setting == i) {
-      SDL_SetRenderDrawColor(timer->settings_ren, highlight.r, highlight.g,
-                             highlight.b, highlight.a);
-      SDL_RenderFillRect(timer->settings_ren, &row_rect);
-    }
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    perror("socket");
+    return 1;
+  }
+  // a socket file nobody answers on is left over from a crash
+  if (connect(listener, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+    fprintf(stderr, "A daemon is already listening on %s\n", path);
+    close(listener);
+    return 1;
+  }
+  close(listener);
+  unlink(path);
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 ||
+      bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listener, 8) != 0) {
+    perror(path);
+    return 1;
+  }
 
-    SDL_Color text_color = (timer->selected_setting == i) ? white : gray;
+  signal(SIGINT, daemon_signal);
+  signal(SIGTERM, daemon_signal);
+  signal(SIGPIPE, SIG_IGN);
 
-    switch (i) {
-    case 0:
-      sprintf(buf, "%s: %d", settings_names[i], timer->config.work_min);
-      break;
-    case 1:
-      sprintf(buf, "%s: %d", settings_names[i], timer->config.break_min);
-      break;
-    case 2:
-      sprintf(buf, "%s: %d", settings_names[i], timer->config.long_break_min);
-      break;
-    case 3:
-      sprintf(buf, "%s: %d", settings_names[i],
-              timer->config.sessions_until_long);
-      break;
-    case 4:
-      sprintf(buf, "%s: %s", settings_names[i],
-              timer->config.sound_on ? "ON" : "OFF");
-      break;
-    case 5:
-      sprintf(buf, "%s: %s", settings_names[i],
-              timer->config.auto_start ? "YES" : "NO");
-      break;
-    case 6:
-      sprintf(buf, "%s: %d%%", settings_names[i], timer->config.opacity);
-      break;
-    case 7:
-      sprintf(buf, "%s: %d", settings_names[i], timer->config.volume);
-      break;
-    case 8:
-      sprintf(buf, "%s: %d", settings_names[i], timer->config.focus_threshold);
+  Timer timer = {w};
+  start_config_writer();
+  load_config(&timer.config);
+  open_journal(&timer.streak);
+  open_status_page();
+  load_countdowns(mono_now());
+  start_hook_runner();
+  timer.sec_remain = timer.config.work_min * 60.0;
+  timer.deadline = mono_now() + timer.sec_remain;
+  check_suspend(&timer);
+  log_event(&timer, JOURNAL_START, 0);
+  publish_status(&timer, mono_now());
+
+  Client clients[MAX_CLIENTS];
+  for (int i = 0; i < MAX_CLIENTS; i++)
+    clients[i].fd = -1;
+  printf("Listening on %s\n", path);
+
+  while (!daemon_quit) {
+    struct pollfd fds[1 + MAX_CLIENTS];
+    fds[0] = (struct pollfd){listener, POLLIN, 0};
+    for (int i = 0; i < MAX_CLIENTS; i++)
+      fds[1 + i] = (struct pollfd){clients[i].fd, POLLIN, 0};
+
+    // sleep until the phase ends, but look in now and then so a suspend
+    // gets noticed soon after resume
+    int timeout = 10000;
+    if (!timer.paused) {
+      double remain = timer.deadline - mono_now();
+      if (remain * 1000 < timeout)
+        timeout = remain > 0 ? (int)ceil(remain * 1000) : 0;
+    }
+    int wheel_ms = countdown_wake_ms(mono_now());
+    if (wheel_ms >= 0 && wheel_ms < timeout)
+      timeout = wheel_ms;
+    if (poll(fds, 1 + MAX_CLIENTS, timeout) < 0 && errno != EINTR) {
+      perror("poll");
       break;
     }
 
-    SDL_Surface *s = TTF_RenderText_Blended(font, buf, text_color);
-    if (s) {
-      SDL_Texture *t = SDL_CreateTextureFromSurface(timer->settings_ren, s);
-      SDL_Rect r = {20, y + (row_h - s->h) / 2, s->w,
-                    s->h}; // Center vertically
-      SDL_RenderCopy(timer->settings_ren, t, NULL, &r);
-      SDL_FreeSurface(s);
-      SDL_DestroyTexture(t);
+    double now = mono_now();
+    bool changed = false;
+    double slept = check_suspend(&timer);
+    if (slept > 0) {
+      handle_suspend(&timer, slept, now);
+      changed = true;
+    }
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(listener, NULL, NULL);
+      int i = 0;
+      while (i < MAX_CLIENTS && clients[i].fd >= 0)
+        i++;
+      if (fd >= 0 && i == MAX_CLIENTS) {
+        close(fd);
+      } else if (fd >= 0) {
+        // never let one client's full buffer stall the timer
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        clients[i] = (Client){fd, {0}, 0, false};
+      }
+    }
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+      if (clients[i].fd >= 0 && fds[1 + i].fd == clients[i].fd &&
+          fds[1 + i].revents)
+        read_client(&timer, &clients[i], now, &changed);
+    }
+    if (update_timer(&timer, now))
+      changed = true;
+    publish_status(&timer, mono_now());
+
+    if (changed) {
+      char line[128];
+      format_status(&timer, mono_now(), line, sizeof(line));
+      for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0 && clients[i].subscribed)
+          send_line(&clients[i], line);
+      }
+    }
+    Countdown *fired;
+    while ((fired = next_fired_countdown(now))) {
+      char line[64];
+      snprintf(line, sizeof(line), "alarm %s\n", fired->name);
+      for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0 && clients[i].subscribed)
+          send_line(&clients[i], line);
+      }
     }
   }
 
-  SDL_RenderSetClipRect(timer->settings_ren, NULL);
-
-  // Scrollbar if needed
-  if (total_h > max_visible_h) {
-    int bar_h = (float)max_visible_h / total_h * max_visible_h;
-    int bar_y = start_y + ((float)timer->settings_scroll_y / max_scroll) *
-                              (max_visible_h - bar_h);
-    SDL_SetRenderDrawColor(timer->settings_ren, 80, 80, 90, 200);
-    SDL_Rect scroll_rect = {390, bar_y, 6, bar_h};
-    SDL_RenderFillRect(timer->settings_ren, &scroll_rect);
+  for (int i = 0; i < MAX_CLIENTS; i++) {
+    if (clients[i].fd >= 0)
+      close(clients[i].fd);
   }
+  close(listener);
+  unlink(path);
+  close_status_page();
+  free_countdowns();
+  stop_hook_runner();
+  stop_config_writer();
+  close_journal();
+  history_free(&timer.streak.history);
+  return 0;
+}
 
-  SDL_RenderPresent(timer->settings_ren);
+// Startup. The window and the ring come up first; the font is read once and
+// rendered into the glyph atlas on an asset thread, and the text appears
+// when assets_ready_event says the atlas can be uploaded. The audio device
+// opens only after a frame with that text is on screen.
+typedef struct {
+  SDL_Thread *thread;
+  void *font_data; // FONT_PATH, shared by every size
+  size_t font_size;
+  TTF_Font *small, *medium, *large;
+  GlyphAtlas atlas;   // metrics only until uploaded
+  SDL_Surface *sheet; // packed glyphs waiting for upload
+  double done_at;     // mono_now()
+} Assets;
+
+Assets assets;
+Uint32 assets_ready_event = (Uint32)-1;
+
+TTF_Font *open_font_size(Assets *a, int size, const char *name) {
+  TTF_Font *font = NULL;
+  if (a->font_data)
+    font = TTF_OpenFontRW(
+        SDL_RWFromConstMem(a->font_data, (int)a->font_size), 1, size);
+  if (!font)
+    fprintf(stderr, "Failed to load %s font: %s\n", name, TTF_GetError());
+  return font;
 }
 
-void open_streak_window(Timer *timer, TTF_Font *font) {
-  if (timer->streak_win)
-    return;
-  timer->streak_win =
-      SDL_CreateWindow("Streak Counter", SDL_WINDOWPOS_CENTERED,
-                       SDL_WINDOWPOS_CENTERED, 750, 250, SDL_WINDOW_SHOWN);
-  timer->streak_ren =
-      SDL_CreateRenderer(timer->streak_win, -1, SDL_RENDERER_ACCELERATED);
+int asset_thread(void *data) {
+  Assets *a = data;
+  a->font_data = SDL_LoadFile(FONT_PATH, &a->font_size);
+  a->small = open_font_size(a, 10, "small");
+  a->large = open_font_size(a, 40, "large");
+  a->sheet = pack_glyph_atlas(&a->atlas, a->large, a->small);
+  if (!a->sheet)
+    fprintf(stderr, "Failed to build glyph atlas\n");
+#if SDL_TTF_VERSION_ATLEAST(2, 0, 18)
+  // the large size is only needed for the atlas, so its face becomes the
+  // medium one rather than parsing the font a third time
+  if (a->large && TTF_SetFontSize(a->large, 16) == 0) {
+    a->medium = a->large;
+    a->large = NULL;
+  }
+#endif
+  if (!a->medium)
+    a->medium = open_font_size(a, 16, "medium");
+  a->done_at = mono_now();
+  if (assets_ready_event != (Uint32)-1) {
+    SDL_Event e = {0};
+    e.type = assets_ready_event;
+    SDL_PushEvent(&e);
+  }
+  return 0;
 }
 
-void render_streak(Timer *timer, TTF_Font *font) {
-  if (!timer->streak_win)
-    return;
-  // GitHub Dark Dimmed background
-  SDL_SetRenderDrawColor(timer->streak_ren, 22, 27, 34, 255);
-  SDL_RenderClear(timer->streak_ren);
+// Nothing else touches SDL_ttf until the thread is done.
+void start_asset_loader(void) {
+  assets_ready_event = SDL_RegisterEvents(1);
+  assets.thread = SDL_CreateThread(asset_thread, "assets", &assets);
+  if (!assets.thread)
+    asset_thread(&assets);
+}
 
-  SDL_Color white = {255, 255, 255, 255};
-  SDL_Color gray = {139, 148, 158, 255};
-  char buf[256];
+// On the GL thread once the assets are in.
+void finish_assets(GlyphAtlas *atlas) {
+  if (assets.thread) {
+    SDL_WaitThread(assets.thread, NULL);
+    assets.thread = NULL;
+  }
+  *atlas = assets.atlas;
+  upload_glyph_atlas(atlas, assets.sheet);
+  assets.sheet = NULL;
+}
 
-  // Header stats
-  // Use a slightly larger size for values? For now just keeping font uniform
-  // but improved positioning
-
-  sprintf(buf, "Daily Sessions: %d", timer->streak.daily_sessions);
-  SDL_Surface *s1 = TTF_RenderText_Blended(font, buf, white);
-  SDL_Texture *t1 = SDL_CreateTextureFromSurface(timer->streak_ren, s1);
-  SDL_Rect r1 = {30, 20, s1->w, s1->h};
-  SDL_RenderCopy(timer->streak_ren, t1, NULL, &r1);
-  SDL_FreeSurface(s1);
-  SDL_DestroyTexture(t1);
-
-  sprintf(buf, "Consecutive Days: %d", timer->streak.consecutive_days);
-  SDL_Surface *s2 = TTF_RenderText_Blended(font, buf, white);
-  SDL_Texture *t2 = SDL_CreateTextureFromSurface(timer->streak_ren, s2);
-  SDL_Rect r2 = {200, 20, s2->w, s2->h};
-  SDL_RenderCopy(timer->streak_ren, t2, NULL, &r2);
-  SDL_FreeSurface(s2);
-  SDL_DestroyTexture(t2);
-
-  sprintf(buf, "Last Active: %s", timer->streak.last_date);
-  SDL_Surface *s3 = TTF_RenderText_Blended(font, buf, gray);
-  SDL_Texture *t3 = SDL_CreateTextureFromSurface(timer->streak_ren, s3);
-  SDL_Rect r3 = {400, 20, s3->w, s3->h};
-  SDL_RenderCopy(timer->streak_ren, t3, NULL, &r3);
-  SDL_FreeSurface(s3);
-  SDL_DestroyTexture(t3);
+void free_assets(void) {
+  if (assets.thread)
+    SDL_WaitThread(assets.thread, NULL);
+  if (assets.sheet)
+    SDL_FreeSurface(assets.sheet);
+  TTF_CloseFont(assets.large);
+  TTF_CloseFont(assets.medium);
+  TTF_CloseFont(assets.small);
+  SDL_free(assets.font_data);
+  memset(&assets, 0, sizeof(assets));
+}
 
-  // GitHub Graph
-  int start_x = 50;
-  int start_y = 80;
-  int sq_size = 10;
-  int gap = 3;
+// --timings: how long each startup step took, printed once the text is up.
+#define MAX_STARTUP_MARKS 16
 
-  // Colors (GitHub Dark)
-  // 0: #161b22, 1: #0e4429, 2: #006d32, 3: #26a641, 4: #39d353
-  SDL_Color c0 = {
-      22, 27, 34,
-      255}; // bg actually but here for empty cells use a lighter shade
-  SDL_Color c_empty = {45, 51, 59, 255}; // Empty cell
-  SDL_Color c1 = {14, 68, 41, 255};
-  SDL_Color c2 = {0, 109, 50, 255};
-  SDL_Color c3 = {38, 166, 65, 255};
-  SDL_Color c4 = {57, 211, 83, 255};
+typedef struct {
+  const char *name;
+  double at; // mono_now()
+} StartupMark;
 
-  // Day labels
-  const char *days[] = {"", "Mon", "", "Wed", "", "Fri", ""};
-  for (int i = 0; i < 7; i++) {
-    if (strlen(days[i]) > 0) {
-      SDL_Surface *ds = TTF_RenderText_Blended(font, days[i], gray);
-      SDL_Texture *dt = SDL_CreateTextureFromSurface(timer->streak_ren, ds);
-      SDL_Rect dr = {10, start_y + i * (sq_size + gap) - 2, ds->w, ds->h};
-      SDL_RenderCopy(timer->streak_ren, dt, NULL, &dr);
-      SDL_FreeSurface(ds);
-      SDL_DestroyTexture(dt);
-    }
-  }
+typedef struct {
+  bool enabled;
+  double start;
+  StartupMark marks[MAX_STARTUP_MARKS];
+  int count;
+} StartupTimings;
 
-  // Month labels
-  const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
-                          "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+StartupTimings startup;
 
-  // Logic to place month labels roughly where the first day of that month
-  // appears Simplified: just evenly spaced for now or based on week index We
-  // are showing 52 weeks ending today.
+void startup_mark(const char *name, double at) {
+  if (startup.count < MAX_STARTUP_MARKS)
+    startup.marks[startup.count++] = (StartupMark){name, at};
+}
 
-  time_t now = time(NULL);
-  struct tm *t_now = localtime(&now);
-  int current_month = t_now->tm_mon; // 0-11
+int cmp_startup_mark(const void *a, const void *b) {
+  double x = ((const StartupMark *)a)->at, y = ((const StartupMark *)b)->at;
+  return x < y ? -1 : x > y;
+}
 
-  // We can just iterate weeks and check if month changed.
+void print_startup_timings(void) {
+  if (!startup.enabled)
+    return;
+  // the asset thread's mark comes in late but may predate others
+  qsort(startup.marks, startup.count, sizeof(StartupMark), cmp_startup_mark);
+  printf("startup, ms since main():\n");
+  double prev = startup.start;
+  for (int i = 0; i < startup.count; i++) {
+    StartupMark *m = &startup.marks[i];
+    printf("  %-16s %7.1f  (+%.1f)\n", m->name, (m->at - startup.start) * 1e3,
+           (m->at - prev) * 1e3);
+    prev = m->at;
+  }
+  startup.enabled = false;
+}
 
-  int prev_mon = -1;
+// --simulate [days]: drives the real timer and streak code on the virtual
+// clock through a scripted stretch of days (some skipped, a random number of
+// sessions on the rest, random pauses), one update per simulated second like
+// the main loop. Checks the long-break cadence and the streak against the
+// script and prints how fast it went. Nothing is read from or written to
+// disk; set TZ to run it across DST changes.
+#define SIM_START_YEAR 2024
+#define SIM_TICK 1.0 // simulated seconds per update
+
+uint32_t sim_rand(uint32_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
 
-  for (int w = 0; w < 52; w++) {
-    // Get date of the first day (Sunday) of this week column
-    int days_ago = (51 - w) * 7 + t_now->tm_wday;
-    time_t cell_time = now - days_ago * 86400;
-    struct tm *cell_tm = localtime(&cell_time);
-
-    if (w == 0 || cell_tm->tm_mon != prev_mon) {
-      // New month
-      SDL_Surface *ms =
-          TTF_RenderText_Blended(font, months[cell_tm->tm_mon], gray);
-      SDL_Texture *mt = SDL_CreateTextureFromSurface(timer->streak_ren, ms);
-      SDL_Rect mr = {start_x + w * (sq_size + gap), start_y - 20, ms->w, ms->h};
-      SDL_RenderCopy(timer->streak_ren, mt, NULL, &mr);
-      SDL_FreeSurface(ms);
-      SDL_DestroyTexture(mt);
-      prev_mon = cell_tm->tm_mon;
+int run_simulation(int days) {
+  if (days <= 0)
+    days = 365;
+  Timer timer = {w};
+  timer.config.work_min = 25;
+  timer.config.break_min = 5;
+  timer.config.long_break_min = 15;
+  timer.config.sessions_until_long = 4;
+  timer.config.auto_start = true;
+  timer.streak.last_day = NO_DAY;
+  timer.streak.history.first_day = timer.streak.history.last_day = NO_DAY;
+
+  // day d of the script starts at 9:00 local on Jan 1 + d
+  struct tm start = {.tm_year = SIM_START_YEAR - 1900, .tm_mday = 1,
+                     .tm_hour = 9, .tm_isdst = -1};
+  virtual_clock = (VirtualClock){true, 0, mktime(&start)};
+
+  uint32_t rng = 0x9e3779b9;
+  long sessions = 0, long_breaks = 0, pauses = 0, updates = 0;
+  int run = 0, last_run = 0, last_count = 0, errors = 0;
+  uint64_t t0 = SDL_GetPerformanceCounter();
+  for (int d = 0; d < days; d++) {
+    struct tm tm = start;
+    tm.tm_mday += d;
+    tm.tm_isdst = -1;
+    double day_start = mktime(&tm) - virtual_clock.wall0;
+    if (day_start < virtual_clock.mono) {
+      fprintf(stderr, "day %d: script overran into the next day\n", d);
+      return 1;
     }
-  }
+    virtual_clock.mono = day_start;
+    int planned = sim_rand(&rng) % 6 == 0 ? 0 : 1 + sim_rand(&rng) % 10;
+    run = planned ? run + 1 : 0;
+    if (!planned)
+      continue;
 
-  // Draw grid
-  for (int w = 0; w < 52; w++) {
-    for (int d = 0; d < 7; d++) {
-      int days_ago = (51 - w) * 7 + (t_now->tm_wday - d);
-      SDL_Color color = c_empty;
-
-      if (days_ago >= 0) {
-        time_t cell_time = now - days_ago * 86400;
-        struct tm *cell_tm = localtime(&cell_time);
-        char cell_date[11];
-        strftime(cell_date, sizeof(cell_date), "%Y-%m-%d", cell_tm);
-
-        int sessions = 0;
-        for (int i = 0; i < timer->streak.history_count; i++) {
-          if (strcmp(timer->streak.history[i].date, cell_date) == 0) {
-            sessions = timer->streak.history[i].sessions;
-            break;
-          }
-        }
-        if (sessions > 0) {
-          if (sessions < 2)
-            color = c1;
-          else if (sessions < 4)
-            color = c2;
-          else if (sessions < 6)
-            color = c3;
-          else
-            color = c4;
-        }
+    reset_timer(&timer, NULL);
+    int done = 0;
+    while (done < planned) {
+      virtual_clock.mono += SIM_TICK;
+      if (sim_rand(&rng) % 4000 == 0) {
+        set_paused(&timer, true, virtual_clock.mono);
+        log_event(&timer, JOURNAL_PAUSE, 1);
+        virtual_clock.mono += 60 + sim_rand(&rng) % 600;
+        set_paused(&timer, false, virtual_clock.mono);
+        log_event(&timer, JOURNAL_PAUSE, 0);
+        pauses++;
       }
-
-      SDL_SetRenderDrawColor(timer->streak_ren, color.r, color.g, color.b,
-                             color.a);
-      // Draw rounded rect if possible, but SDL_RenderFillRect is just rect.
-      SDL_Rect rect = {start_x + w * (sq_size + gap),
-                       start_y + d * (sq_size + gap), sq_size, sq_size};
-      SDL_RenderFillRect(timer->streak_ren, &rect);
+      State before = timer.state;
+      updates++;
+      if (!update_timer(&timer, virtual_clock.mono) || before != w)
+        continue;
+      done++;
+      sessions++;
+      if (timer_phase(&timer) == PHASE_LONG_BREAK)
+        long_breaks++;
+    }
+    set_paused(&timer, true, virtual_clock.mono);
+
+    int day = local_day(wall_now());
+    int got = history_get(&timer.streak.history, day);
+    if (got != planned) {
+      char buf[11];
+      format_day(day, buf);
+      fprintf(stderr, "%s: history has %d sessions, script did %d\n", buf,
+              got, planned);
+      errors++;
     }
+    last_run = run;
+    last_count = planned;
   }
+  double real = (double)(SDL_GetPerformanceCounter() - t0) /
+                SDL_GetPerformanceFrequency();
 
-  // Legend
-  int leg_x = start_x + 52 * (sq_size + gap) - 100;
-  int leg_y = start_y + 7 * (sq_size + gap) + 15;
+  if (long_breaks != sessions / timer.config.sessions_until_long) {
+    fprintf(stderr, "%ld long breaks after %ld sessions, expected %ld\n",
+            long_breaks, sessions, sessions / timer.config.sessions_until_long);
+    errors++;
+  }
+  if (timer.streak.consecutive_days != last_run ||
+      timer.streak.daily_sessions != last_count) {
+    fprintf(stderr, "streak is %d days / %d sessions, expected %d / %d\n",
+            timer.streak.consecutive_days, timer.streak.daily_sessions,
+            last_run, last_count);
+    errors++;
+  }
 
-  SDL_Surface *ls = TTF_RenderText_Blended(font, "Less", gray);
-  SDL_Texture *lt = SDL_CreateTextureFromSurface(timer->streak_ren, ls);
-  SDL_Rect lr = {leg_x - ls->w - 5, leg_y - 2, ls->w, ls->h};
-  SDL_RenderCopy(timer->streak_ren, lt, NULL, &lr);
-  SDL_FreeSurface(ls);
-  SDL_DestroyTexture(lt);
+  char first[11], last[11];
+  format_day(timer.streak.history.first_day, first);
+  format_day(timer.streak.history.last_day, last);
+  printf("Simulated %d days (%.0f s) in %.3f s: %.1fM sim s/s, %.1fM "
+         "updates/s\n",
+         days, virtual_clock.mono, real, virtual_clock.mono / real / 1e6,
+         updates / real / 1e6);
+  printf("%ld sessions, %ld long breaks, %ld pauses\n", sessions, long_breaks,
+         pauses);
+  printf("Streak: %d days, %d sessions on %s, history %s..%s in %d chunks\n",
+         timer.streak.consecutive_days, timer.streak.daily_sessions, last,
+         first, last, timer.streak.history.num_chunks);
+  history_free(&timer.streak.history);
+  virtual_clock.on = false;
+  if (errors)
+    printf("%d mismatches\n", errors);
+  return errors ? 1 : 0;
+}
 
-  SDL_Color colors[] = {c_empty, c1, c2, c3, c4};
-  for (int i = 0; i < 5; i++) {
-    SDL_SetRenderDrawColor(timer->streak_ren, colors[i].r, colors[i].g,
-                           colors[i].b, colors[i].a);
-    SDL_Rect lrect = {leg_x + i * (sq_size + gap), leg_y, sq_size, sq_size};
-    SDL_RenderFillRect(timer->streak_ren, &lrect);
-  }
+// --bench-io [iters]: times the streak and config persistence paths on
+// synthetic histories of 1, 365 and 3650 days. Each op gets a warm-up batch
+// and then BENCH_IO_BATCHES timed batches of iters ops; we print the best and
+// median ns/op, the net heap growth per op (a leak shows up here, a
+// malloc/free pair doesn't) and, from one more untimed batch, how many bytes
+// each op wrote. Runs in a scratch directory, so your streak.txt and
+// pomo.cfg are left alone.
+#define BENCH_IO_BATCHES 5
+
+typedef struct {
+  Streak streak;
+  Config cfg;
+  int i; // ops run so far
+} IoBenchState;
+
+typedef struct {
+  const char *name;
+  void (*op)(IoBenchState *st);
+  const char *files[2]; // what the op writes, for bytes/op
+  bool per_history; // cost depends on the history length
+} IoBench;
 
-  SDL_Surface *ms2 = TTF_RenderText_Blended(font, "More", gray);
-  SDL_Texture *mt2 = SDL_CreateTextureFromSurface(timer->streak_ren, ms2);
-  SDL_Rect mr2 = {leg_x + 5 * (sq_size + gap) + 5, leg_y - 2, ms2->w, ms2->h};
-  SDL_RenderCopy(timer->streak_ren, mt2, NULL, &mr2);
-  SDL_FreeSurface(ms2);
-  SDL_DestroyTexture(mt2);
+void bench_load_streak(IoBenchState *st) { load_streak(&st->streak); }
 
-  SDL_RenderPresent(timer->streak_ren);
+void bench_save_streak(IoBenchState *st) { save_streak(&st->streak); }
+
+void bench_apply_session(IoBenchState *st) {
+  apply_session(&st->streak, st->streak.last_day);
 }
 
-void snap_to_corner(SDL_Window *window) {
-  int displayIndex = SDL_GetWindowDisplayIndex(window);
-  if (displayIndex < 0)
-    return;
+// a work session ending and the break starting, with the config writer
+// running like in the app: the write and fsync are timed here, the
+// compaction every JOURNAL_COMPACT_RECORDS happens on the writer thread
+void bench_session_end(IoBenchState *st) {
+  journal_append(&st->streak, JOURNAL_END, PHASE_WORK, 0);
+  journal_append(&st->streak, JOURNAL_START, PHASE_BREAK, 0);
+}
 
-  SDL_Rect usableBounds;
-  if (SDL_GetDisplayUsableBounds(displayIndex, &usableBounds) != 0)
-    return;
+void bench_load_config(IoBenchState *st) { load_config(&st->cfg); }
 
-  int wx, wy, ww_local, wh_local;
-  SDL_GetWindowPosition(window, &wx, &wy);
-  SDL_GetWindowSize(window, &ww_local, &wh_local);
+// different from what's on disk every time, so it actually writes
+void bench_save_config(IoBenchState *st) {
+  st->cfg.x = st->i;
+  save_config(&st->cfg);
+}
 
-  // 4 corners of the usable bounds
-  SDL_Point corners[] = {
-      {usableBounds.x, usableBounds.y},                             // Top-Left
-      {usableBounds.x + usableBounds.w - ww_local, usableBounds.y}, // Top-Right
-      {usableBounds.x,
-       usableBounds.y + usableBounds.h - wh_local}, // Bottom-Left
-      {usableBounds.x + usableBounds.w - ww_local,
-       usableBounds.y + usableBounds.h - wh_local} // Bottom-Right
-  };
+const IoBench io_benches[] = {
+    {"load_streak", bench_load_streak, {NULL}, true},
+    {"save_streak", bench_save_streak, {STREAK_PATH}, true},
+    {"apply_session", bench_apply_session, {NULL}, true},
+    {"session end", bench_session_end, {JOURNAL_PATH, STREAK_PATH}, true},
+    {"load_config", bench_load_config, {NULL}, false},
+    {"save_config", bench_save_config, {CONFIG_PATH}, false},
+};
+
+size_t heap_in_use(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  struct mallinfo2 mi = mallinfo2();
+  return mi.uordblks + mi.hblkhd;
+#else
+  return 0;
+#endif
+}
 
-  SDL_Point nearestCorner = corners[0];
-  long min_dist_sq = 2000000000; // Large enough
+// Bytes written to path since before was taken: all of it if the file was
+// replaced (our saves rename a new file over), else whatever it grew by.
+long bytes_written(const char *path, struct stat *before) {
+  struct stat st;
+  if (stat(path, &st) != 0)
+    st = (struct stat){0};
+  long n = st.st_ino != before->st_ino ? st.st_size
+           : st.st_size > before->st_size ? st.st_size - before->st_size
+                                          : 0;
+  *before = st;
+  return n;
+}
 
-  for (int i = 0; i < 4; i++) {
-    long dx = (long)wx - corners[i].x;
-    long dy = (long)wy - corners[i].y;
-    long dist_sq = dx * dx + dy * dy;
-    if (dist_sq < min_dist_sq) {
-      min_dist_sq = dist_sq;
-      nearestCorner = corners[i];
-    }
+void fill_history(Streak *s, int days) {
+  remove(STREAK_PATH);
+  load_streak(s); // nothing there now, so this just resets it
+  int today = local_day(wall_now());
+  for (int i = days - 1; i >= 0; i--)
+    history_set(&s->history, today - i, 1 + (i * 7) % 9);
+  s->last_day = today;
+  s->daily_sessions = history_get(&s->history, today);
+  s->consecutive_days = days;
+  save_streak(s);
+}
+
+void run_io_bench(const IoBench *b, int days, int iters) {
+  IoBenchState st = {0};
+  fill_history(&st.streak, days);
+  remove(JOURNAL_PATH);
+  remove(CONFIG_PATH);
+  load_config(&st.cfg);
+  if (b->op == bench_session_end) {
+    start_config_writer();
+    open_journal(&st.streak);
   }
 
-  // Set window position. Note: SDL2 doesn't have built-in smooth animation
-  // like Cocoa's animate:YES, so it will snap instantly. To animate,
-  // one would need a custom interpolation loop.
-  SDL_SetWindowPosition(window, nearestCorner.x, nearestCorner.y);
+  double ns[BENCH_IO_BATCHES];
+  long heap = 0; // may shrink, e.g. a compaction freeing its snapshot
+  for (int batch = -1; batch < BENCH_IO_BATCHES; batch++) {
+    size_t heap_before = heap_in_use();
+    Uint64 t0 = SDL_GetPerformanceCounter();
+    for (int i = 0; i < iters; i++, st.i++)
+      b->op(&st);
+    Uint64 t1 = SDL_GetPerformanceCounter();
+    if (batch < 0)
+      continue; // warm-up
+    ns[batch] = (double)(t1 - t0) * 1e9 / SDL_GetPerformanceFrequency();
+    ns[batch] /= iters;
+    heap += (long)(heap_in_use() - heap_before);
+  }
+  // stat()ing around every op would skew the timings, so count separately
+  long bytes = 0;
+  struct stat before[2] = {0};
+  for (int f = 0; f < 2 && b->files[f]; f++)
+    bytes_written(b->files[f], &before[f]);
+  for (int i = 0; i < iters; i++, st.i++) {
+    b->op(&st);
+    for (int f = 0; f < 2 && b->files[f]; f++)
+      bytes += bytes_written(b->files[f], &before[f]);
+  }
+  // plus whatever the writer thread still had to do
+  stop_config_writer();
+  for (int f = 0; f < 2 && b->files[f]; f++)
+    bytes += bytes_written(b->files[f], &before[f]);
+  close_journal();
+  history_free(&st.streak.history);
+
+  qsort(ns, BENCH_IO_BATCHES, sizeof(double), compare_doubles);
+  long ops = (long)iters * BENCH_IO_BATCHES;
+  char label[8] = "-";
+  if (b->per_history)
+    snprintf(label, sizeof(label), "%d", days);
+  printf("%-14s %5s %12.0f %12.0f %10.1f %10.1f\n", b->name, label, ns[0],
+         ns[BENCH_IO_BATCHES / 2], (double)heap / ops, (double)bytes / iters);
+}
 
-  // Save new position
-  void *data = SDL_GetWindowData(window, "timer");
-  if (data) {
-    Timer *timer = (Timer *)data;
-    timer->config.x = nearestCorner.x;
-    timer->config.y = nearestCorner.y;
-    save_config(&timer->config);
+int run_io_benchmarks(int iters) {
+  char dir[] = "/tmp/pomobench.XXXXXX";
+  int home = open(".", O_RDONLY);
+  if (home < 0 || !mkdtemp(dir) || chdir(dir) != 0) {
+    fprintf(stderr, "Failed to set up a scratch directory\n");
+    return 1;
+  }
+  printf("%d ops x %d batches each, in %s\n", iters, BENCH_IO_BATCHES, dir);
+  printf("%-14s %5s %12s %12s %10s %10s\n", "op", "days", "best ns/op",
+         "median ns/op", "grown B/op", "written B/op");
+  const int sizes[] = {1, 365, 3650};
+  for (size_t i = 0; i < sizeof(io_benches) / sizeof(io_benches[0]); i++) {
+    const IoBench *b = &io_benches[i];
+    for (int j = 0; j < (b->per_history ? 3 : 1); j++)
+      run_io_bench(b, sizes[j], iters);
+  }
+
+  remove(STREAK_PATH);
+  remove(JOURNAL_PATH);
+  remove(CONFIG_PATH);
+  if (fchdir(home) != 0 || rmdir(dir) != 0)
+    fprintf(stderr, "Left %s behind\n", dir);
+  close(home);
+  return 0;
+}
+
+// The main window and its GL context, made current. 4x MSAA only for the
+// fixed-function ring, and without it if there's no such visual.
+SDL_Window *create_gl_window(const Config *cfg, bool msaa,
+                             SDL_GLContext *context) {
+  SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, msaa ? 1 : 0);
+  SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, msaa ? 4 : 0);
+  Uint32 flags = SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_BORDERLESS;
+  SDL_Window *window =
+      SDL_CreateWindow("pomopomo", cfg->x, cfg->y, ww, wh, flags);
+  if (!window && msaa)
+    return create_gl_window(cfg, false, context);
+  if (!window) {
+    fprintf(stderr, "Window creation failed: %s\n", SDL_GetError());
+    return NULL;
+  }
+  *context = SDL_GL_CreateContext(window);
+  if (!*context) {
+    fprintf(stderr, "GL Context creation failed: %s\n", SDL_GetError());
+    SDL_DestroyWindow(window);
+    return NULL;
   }
+  SDL_GL_MakeCurrent(window, *context);
+  return window;
 }
 
 int main(int argc, char *argv[]) {
+  int bench_frames = 0;
+  bool fixed_function = false; // skip the ring shader, use MSAA instead
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--bench-render") == 0) {
+      bench_frames = (i + 1 < argc) ? atoi(argv[++i]) : 5000;
+      if (bench_frames <= 0)
+        bench_frames = 5000;
+    } else if (strcmp(argv[i], "--fixed-function") == 0) {
+      fixed_function = true;
+    } else if (strcmp(argv[i], "--timings") == 0) {
+      startup.enabled = true;
+    } else if (strcmp(argv[i], "--verbose") == 0) {
+      verbose = true;
+    } else if (strcmp(argv[i], "--print-idle") == 0) {
+      return print_idle_sources();
+    } else if (strcmp(argv[i], "--status") == 0) {
+      return print_status();
+    } else if (strcmp(argv[i], "--daemon") == 0) {
+      return run_daemon(i + 1 < argc ? argv[i + 1] : DAEMON_SOCKET);
+    } else if (strcmp(argv[i], "--bench-io") == 0) {
+      int iters = i + 1 < argc ? atoi(argv[i + 1]) : 0;
+      return run_io_benchmarks(iters > 0 ? iters : 200);
+    } else if (strcmp(argv[i], "--simulate") == 0) {
+      return run_simulation(i + 1 < argc ? atoi(argv[i + 1]) : 365);
+    }
+  }
+
+  startup.start = mono_now();
   if (SDL_Init(SDL_INIT_VIDEO) < 0)
     return 1;
   TTF_Init();
+  startup_mark("sdl init", mono_now());
+  if (!bench_frames)
+    start_asset_loader();
 
-  SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
-  SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4);
-
-  TTF_Font *font_small = TTF_OpenFont(FONT_PATH, 10);
-  TTF_Font *font_medium = TTF_OpenFont(FONT_PATH, 16);
+  // set once the asset thread is done
+  TTF_Font *font_small = NULL, *font_medium = NULL;
 
   Timer timer = {w};
-  timer.last_frame_time = SDL_GetTicks();
+  // the bench opens and closes the settings window, which saves
+  if (bench_frames)
+    config_writer.read_only = true;
+  else
+    start_config_writer();
   load_config(&timer.config);
-  load_streak(&timer.streak);
+  if (bench_frames)
+    load_streak(&timer.streak);
+  else
+    open_journal(&timer.streak);
   timer.sec_remain = timer.config.work_min * 60.0;
+  timer.deadline = mono_now() + timer.sec_remain;
+  check_suspend(&timer);
+  if (!bench_frames)
+    log_event(&timer, JOURNAL_START, 0);
+  startup_mark("config + streak", mono_now());
 
   // wimndow
-  SDL_Window *window = SDL_CreateWindow(
-      "pomopomo", timer.config.x, timer.config.y, ww, wh,
-      SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_BORDERLESS);
-
-  if (!window) {
-    fprintf(stderr, "Window creation failed: %s\n", SDL_GetError());
+  SDL_GLContext context = NULL;
+  SDL_Window *window =
+      create_gl_window(&timer.config, fixed_function, &context);
+  if (!window)
     return 1;
+  // the shader needs no MSAA, so the window only gets a multisampled
+  // buffer when the shader can't be used. that has to be picked before the
+  // window exists, so start over with one.
+  RingGeometry ring_geo = {0};
+  if (!fixed_function && !init_ring_shader(&ring_geo)) {
+    fprintf(stderr, "Ring shader unavailable, using fixed-function path\n");
+    fixed_function = true;
+    SDL_GL_DeleteContext(context);
+    SDL_DestroyWindow(window);
+    window = create_gl_window(&timer.config, true, &context);
+    if (!window)
+      return 1;
   }
+  startup_mark("window", mono_now());
 
   // If we used centered, set the real position now
   int actualX, actualY;
   SDL_GetWindowPosition(window, &actualX, &actualY);
   timer.config.x = actualX;
   timer.config.y = actualY;
-  save_config(&timer.config);
+  if (!bench_frames)
+    save_config(&timer.config);
+  bool watching_config = !bench_frames && start_config_watcher();
+  if (!bench_frames) {
+    start_idle_monitor(timer.config.focus_threshold);
+    open_status_page();
+    load_countdowns(mono_now());
+    start_hook_runner();
+  }
 
   SDL_SetWindowHitTest(window, drag_hit_test, NULL);
   SDL_SetWindowData(window, "timer", &timer);
-  CachedText time_cache = {0}, label_cache = {0};
+  GlyphAtlas atlas = {0};
   bool running = true;
   SDL_Event e;
+  bool visible = !(SDL_GetWindowFlags(window) &
+                   (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED));
+  bool redraw = true;
+  bool first_frame = false, text_ready = false, text_shown = false;
+  char drawn_time[16] = "", drawn_label[64] = "";
 
-  SDL_GLContext context = SDL_GL_CreateContext(window);
-  if (!context) {
-    fprintf(stderr, "GL Context creation failed: %s\n", SDL_GetError());
-    return 1;
-  }
-  SDL_GL_MakeCurrent(window, context);
   SDL_GL_SetSwapInterval(1); // VSYNCCCCCCC!!!
   // Transparency removed as requested
   // SDL_SetWindowOpacity(window, timer.config.opacity / 100.0f);
 
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glEnable(GL_MULTISAMPLE);
-
-  TTF_Font *font_large = TTF_OpenFont(FONT_PATH, 40);
-  if (!font_large) {
-    fprintf(stderr, "Failed to load large font: %s\n", TTF_GetError());
-  }
-  if (!font_medium) {
-    fprintf(stderr, "Failed to load medium font: %s\n", TTF_GetError());
-  }
-  if (!font_small) {
-    fprintf(stderr, "Failed to load small font: %s\n", TTF_GetError());
-  }
-
-  if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) {
-    fprintf(stderr, "SDL_mixer could not initialize! SDL_mixer Error: %s\n",
-            Mix_GetError());
-  }
-  timer.music = Mix_LoadMUS("res/timer.mp3");
-  if (timer.music && timer.config.sound_on) {
-    Mix_PlayMusic(timer.music, -1);
-  } else if (!timer.music) {
-    fprintf(stderr, "Failed to load music: %s\n", Mix_GetError());
+  if (fixed_function)
+    glEnable(GL_MULTISAMPLE);
+
+  // the window never resizes, so the projection is set up once
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glOrtho(0, ww, wh, 0, -1, 1);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+
+  startup_mark("gl context", mono_now());
+
+  init_ring_geometry(&ring_geo);
+  startup_mark("ring", mono_now());
+
+  if (bench_frames) {
+    asset_thread(&assets);
+    finish_assets(&atlas);
+    font_small = assets.small;
+    font_medium = assets.medium;
+    run_render_bench(&timer, window, &ring_geo, &atlas, font_medium,
+                     font_small, bench_frames);
+    running = false;
   }
 
   while (running) {
-    while (SDL_PollEvent(&e)) {
+    // sleep until an event arrives or the next visible change is due
+    int have_event = SDL_WaitEventTimeout(
+        &e, next_wake_ms(&timer, visible, SDL_GetTicks()));
+    for (; have_event; have_event = SDL_PollEvent(&e)) {
       if (e.type == SDL_QUIT)
         running = false;
 
+      if (e.type == assets_ready_event) {
+        finish_assets(&atlas);
+        font_small = assets.small;
+        font_medium = assets.medium;
+        text_ready = true;
+        startup_mark("assets (thread)", assets.done_at);
+        startup_mark("text", mono_now());
+        if (first_frame)
+          print_startup_timings();
+      }
+
+      // anything but plain mouse movement may change what's on screen
+      if (e.type != SDL_MOUSEMOTION)
+        redraw = true;
+
+      if (e.type == SDL_WINDOWEVENT &&
+          e.window.windowID == SDL_GetWindowID(window)) {
+        switch (e.window.event) {
+        case SDL_WINDOWEVENT_HIDDEN:
+        case SDL_WINDOWEVENT_MINIMIZED:
+          visible = false;
+          break;
+        case SDL_WINDOWEVENT_SHOWN:
+        case SDL_WINDOWEVENT_RESTORED:
+        case SDL_WINDOWEVENT_EXPOSED:
+          visible = true;
+          break;
+        }
+      }
+      if (e.type == SDL_WINDOWEVENT && timer.settings_win &&
+          e.window.windowID == SDL_GetWindowID(timer.settings_win) &&
+          (e.window.event == SDL_WINDOWEVENT_EXPOSED ||
+           e.window.event == SDL_WINDOWEVENT_SHOWN ||
+           e.window.event == SDL_WINDOWEVENT_RESTORED)) {
+        timer.settings_view.dirty = true;
+      }
+      if (e.type == SDL_WINDOWEVENT && timer.streak_win &&
+          e.window.windowID == SDL_GetWindowID(timer.streak_win) &&
+          (e.window.event == SDL_WINDOWEVENT_EXPOSED ||
+           e.window.event == SDL_WINDOWEVENT_SHOWN ||
+           e.window.event == SDL_WINDOWEVENT_RESTORED)) {
+        timer.streak_view.dirty = true;
+      }
+      if (e.type == SDL_RENDER_TARGETS_RESET ||
+          e.type == SDL_RENDER_DEVICE_RESET) {
+        timer.streak_view.stale = true;
+      }
+
       if (e.type == SDL_WINDOWEVENT &&
           e.window.event == SDL_WINDOWEVENT_CLOSE) {
         if (timer.settings_win &&
             e.window.windowID == SDL_GetWindowID(timer.settings_win)) {
-          SDL_DestroyRenderer(timer.settings_ren);
-          SDL_DestroyWindow(timer.settings_win);
-          timer.settings_win = NULL;
-          timer.settings_ren = NULL;
-          save_config(&timer.config);
+          close_settings_window(&timer);
         } else if (timer.streak_win &&
                    e.window.windowID == SDL_GetWindowID(timer.streak_win)) {
-          SDL_DestroyRenderer(timer.streak_ren);
-          SDL_DestroyWindow(timer.streak_win);
-          timer.streak_win = NULL;
-          timer.streak_ren = NULL;
+          close_streak_window(&timer);
         } else {
           running = false;
         }
@@ -934,45 +5011,51 @@ int main(int argc, char *argv[]) {
 
       if (e.type == SDL_KEYDOWN || e.type == SDL_MOUSEBUTTONDOWN ||
           e.type == SDL_MOUSEMOTION || e.type == SDL_MOUSEWHEEL) {
-        timer.is_away = false;
+        timer.user_idle = false;
+        if (timer.is_away) {
+          timer.is_away = false;
+          log_event(&timer, JOURNAL_AWAY, 0);
+        }
         if (timer.is_shaking) {
-          SDL_SetWindowPosition(window, timer.base_x, timer.base_y);
           timer.is_shaking = false;
           timer.pause_duration = 0;
+          timer.paused_at = mono_now();
         }
       }
+      // grabbing the window again cancels a corner glide in progress
+      if (e.type == SDL_MOUSEBUTTONDOWN &&
+          e.button.windowID == SDL_GetWindowID(window)) {
+        anim_stop(&timer.anim, ANIM_SNAP_X);
+        anim_stop(&timer.anim, ANIM_SNAP_Y);
+      }
 
       if (e.type == SDL_KEYDOWN) {
         if (e.key.keysym.sym == SDLK_SPACE) {
-          timer.paused = !timer.paused;
-          if (timer.paused)
-            Mix_PauseMusic();
-          else
-            Mix_ResumeMusic();
+          set_paused(&timer, !timer.paused, mono_now());
+          log_event(&timer, JOURNAL_PAUSE, timer.paused);
         } else if (e.key.keysym.sym == SDLK_r) {
-          reset_timer(&timer, window);
-        } else if (e.key.keysym.sym == SDLK_s) {
+          if (timer.view > 0)
+            restart_countdown(&countdowns.items[timer.view - 1], mono_now());
+          else
+            reset_timer(&timer, window);
+          redraw = true;
+        } else if (e.key.keysym.sym == SDLK_TAB) {
+          timer.view = (timer.view + 1) % (countdowns.count + 1);
+          redraw = true;
+        } else if (e.key.keysym.sym == SDLK_s && font_medium) {
           if (!timer.settings_win)
             open_settings_window(&timer, font_medium);
-          else {
-            SDL_DestroyRenderer(timer.settings_ren);
-            SDL_DestroyWindow(timer.settings_win);
-            timer.settings_win = NULL;
-            timer.settings_ren = NULL;
-            save_config(&timer.config);
-          }
-        } else if (e.key.keysym.sym == SDLK_o) {
+          else
+            close_settings_window(&timer);
+        } else if (e.key.keysym.sym == SDLK_o && font_small) {
           if (!timer.streak_win)
             open_streak_window(&timer, font_small);
-          else {
-            SDL_DestroyRenderer(timer.streak_ren);
-            SDL_DestroyWindow(timer.streak_win);
-            timer.streak_win = NULL;
-            timer.streak_ren = NULL;
-          }
+          else
+            close_streak_window(&timer);
         }
 
         if (timer.settings_win) {
+          timer.settings_view.dirty = true;
           if (e.key.keysym.sym == SDLK_UP) {
             timer.selected_setting = (timer.selected_setting - 1 + 9) % 9;
           } else if (e.key.keysym.sym == SDLK_DOWN) {
@@ -1017,13 +5100,8 @@ int main(int argc, char *argv[]) {
             if (timer.selected_setting == 6) {
               // SDL_SetWindowOpacity(window, timer.config.opacity / 100.0f);
             }
-            if (timer.selected_setting == 4 || timer.selected_setting == 7) {
+            if (timer.selected_setting == 7 && timer.audio_open)
               Mix_VolumeMusic(timer.config.volume);
-              if (timer.config.sound_on)
-                Mix_ResumeMusic();
-              else
-                Mix_HaltMusic();
-            }
             save_config(&timer.config);
           }
         }
@@ -1041,8 +5119,9 @@ int main(int argc, char *argv[]) {
         int scrolled_y = my + timer.settings_scroll_y;
         if (my >= start_y && my < 450) {
           int row = (scrolled_y - start_y) / row_h;
-          if (row >= 0 && row < 9) {
+          if (row >= 0 && row < 9 && row != timer.selected_setting) {
             timer.selected_setting = row;
+            timer.settings_view.dirty = true;
           }
         }
       }
@@ -1050,6 +5129,7 @@ int main(int argc, char *argv[]) {
       if (timer.settings_win && e.type == SDL_MOUSEWHEEL &&
           e.wheel.windowID == SDL_GetWindowID(timer.settings_win)) {
         timer.settings_scroll_y -= e.wheel.y * 20; // Scroll speed
+        timer.settings_view.dirty = true;
         // Clamping happens in render_settings for visual simplicity
         // but good to clamp here too if we used scroll_y elsewhere immediately
       }
@@ -1064,6 +5144,7 @@ int main(int argc, char *argv[]) {
         if (my >= start_y && my < 450) {
           int row = (scrolled_y - start_y) / row_h;
           if (row >= 0 && row < 9 && timer.selected_setting == row) {
+            timer.settings_view.dirty = true;
             // Simulate LEFT/RIGHT key logic
             int dir = (e.button.button == SDL_BUTTON_LEFT) ? 1 : -1;
             // For boolean toggles, any click toggles it
@@ -1104,36 +5185,27 @@ int main(int argc, char *argv[]) {
                   fmax(5, timer.config.focus_threshold + dir * 5);
               break;
             }
-            if (timer.selected_setting == 4 || timer.selected_setting == 7) {
+            if (timer.selected_setting == 7 && timer.audio_open)
               Mix_VolumeMusic(timer.config.volume);
-              if (timer.config.sound_on)
-                Mix_ResumeMusic();
-              else
-                Mix_HaltMusic();
-            }
             save_config(&timer.config);
           }
         }
       }
 
       if (e.type == SDL_WINDOWEVENT &&
-          e.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
-        Config old = timer.config;
-
-        load_config(&timer.config);
-        if (old.work_min != timer.config.work_min ||
-            old.break_min != timer.config.break_min) {
-          reset_timer(&timer, window);
-        }
-        if (old.sound_on != timer.config.sound_on) {
-          if (timer.config.sound_on) {
-            Mix_PlayMusic(timer.music, -1);
-          } else {
-            Mix_HaltMusic();
-          }
-        }
+          e.window.event == SDL_WINDOWEVENT_FOCUS_GAINED &&
+          !watching_config) {
+        reload_config(&timer, window);
+      }
+      if (e.type == idle_changed_event)
+        timer.user_idle = e.user.code;
+      if (e.type == config_changed_event) {
+        // clear first so an edit landing during the reload queues another
+        SDL_AtomicSet(&config_watcher.posted, 0);
+        reload_config(&timer, window);
       }
-      if (e.type == SDL_MOUSEBUTTONUP) {
+      if (e.type == SDL_MOUSEBUTTONUP &&
+          e.button.windowID == SDL_GetWindowID(window)) {
         int wx, wy;
         SDL_GetWindowPosition(window, &wx, &wy);
         timer.config.x = wx;
@@ -1143,103 +5215,33 @@ int main(int argc, char *argv[]) {
       }
     }
     uint32_t now = SDL_GetTicks();
-    double dt = (now - timer.last_frame_time) / 1000.0;
-    timer.last_frame_time = now;
-
-    // Focus detection (macOS only)
-#ifdef __APPLE__
-    double idle = CGEventSourceSecondsSinceLastEventType(
-        kCGEventSourceStateCombinedSessionState, kCGAnyInputEventType);
-    if (idle > timer.config.focus_threshold && timer.state == w &&
-        !timer.paused) {
-      timer.paused = true;
-      timer.is_away = true;
-      Mix_PauseMusic();
-    }
-#endif
-
-    if (!timer.paused) {
-      if (timer.is_shaking) {
-        SDL_SetWindowPosition(window, timer.base_x, timer.base_y);
-        timer.is_shaking = false;
-      }
-      timer.pause_duration = 0;
-      timer.sec_remain -= dt;
-      if (timer.state == w)
-        timer.elapsed_work += dt;
-      else
-        timer.elapsed_break += dt;
-
-      if (timer.sec_remain <= 0) {
-        if (timer.state == w) {
-          timer.session_count++;
-          update_streak(&timer.streak);
-          if (timer.session_count % timer.config.sessions_until_long == 0) {
-            timer.state = b;
-            timer.sec_remain = timer.config.long_break_min * 60.0;
-          } else {
-            timer.state = b;
-            timer.sec_remain = timer.config.break_min * 60.0;
-          }
-        } else {
-          timer.state = w;
-          timer.sec_remain = timer.config.work_min * 60.0;
-          timer.elapsed_work = 0;
-          timer.elapsed_break = 0;
-        }
-        if (!timer.config.auto_start) {
-          timer.paused = true;
-          Mix_PauseMusic();
-        }
-      }
-    } else {
-      timer.pause_duration += dt;
-      if (timer.pause_duration > 300.0 && timer.state == w) { // 5 minutes
-        if (!timer.is_shaking) {
-          SDL_GetWindowPosition(window, &timer.base_x, &timer.base_y);
-          timer.is_shaking = true;
-        }
-        int offsetX = (rand() % 5) - 2;
-        int offsetY = (rand() % 5) - 2;
-        SDL_SetWindowPosition(window, timer.base_x + offsetX,
-                              timer.base_y + offsetY);
-      }
+    double now_s = mono_now();
+    double slept = check_suspend(&timer);
+    if (slept > 0)
+      handle_suspend(&timer, slept, now_s);
+
+    update_timer(&timer, now_s);
+    apply_idle(&timer, now_s);
+    publish_status(&timer, now_s);
+    Countdown *fired;
+    while ((fired = next_fired_countdown(now_s))) {
+      verbose_log("%s is up\n", fired->name);
+      // the device may have been closed while the pomodoro sat paused
+      if (!timer.audio_open && timer.config.sound_on && open_audio(&timer))
+        Mix_PauseMusic();
+      play_chime(&timer.config, CHIME_BREAK_END);
+      redraw = true;
     }
 
-    // sync audio
-    if (timer.music && !timer.paused && timer.config.sound_on) {
-      double target_pos;
-      if (timer.state == w) {
-        target_pos = fmod(timer.elapsed_work, 1500.0);
-      } else {
-        target_pos = 1500.0 + fmod(timer.elapsed_break, 300.0);
-      }
-
-      double music_pos = Mix_GetMusicPosition(timer.music);
-      if (fabs(music_pos - target_pos) > 1.0) {
-        Mix_SetMusicPosition(target_pos);
-      }
+    // from the settings keys or a config reload
+    set_idle_threshold(timer.config.focus_threshold);
+    sync_animations(&timer, now);
+    if (anim_active(&timer.anim, ANIM_SNAP_X)) {
+      SDL_SetWindowPosition(
+          window, (int)roundf(anim_value(&timer.anim, ANIM_SNAP_X, now)),
+          (int)roundf(anim_value(&timer.anim, ANIM_SNAP_Y, now)));
     }
 
-    glClearColor(0.10f, 0.12f, 0.18f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, ww, wh, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
-    // Solid background disc
-    draw_filled_circle(ww / 2.0f, wh / 2.0f, 100, 0.15f, 0.17f, 0.25f, 1.0f);
-
-    // back ringy
-    draw_ring_segment(ww / 2.0f, wh / 2.0f, 80, 75, 0, 360, 0.15f, 0.17f, 0.25f,
-                      1.0f);
-
-    // progress
-    double total = (timer.state == w) ? timer.config.work_min * 60.0
-                                      : timer.config.break_min * 60.0;
-
     // Draw settings if open
     if (timer.settings_win) {
       render_settings(&timer, font_medium);
@@ -1247,56 +5249,48 @@ int main(int argc, char *argv[]) {
     if (timer.streak_win) {
       render_streak(&timer, font_small);
     }
-    float progress = (float)(timer.sec_remain / total);
-    if (progress < 0)
-      progress = 0;
-
-    float ring_r = (timer.state == w) ? 1.0f : 0.4f;
-    float ring_g = (timer.state == w) ? 0.45f : 0.85f;
-    float ring_b = (timer.state == w) ? 0.45f : 1.0f;
-    draw_ring_segment(ww / 2.0f, wh / 2.0f, 80, 75, 0, 360.0f * progress,
-                      ring_r, ring_g, ring_b, 1.0f);
-
-    // time txt
-    char spiderman[16];
-    int display_secs = (int)ceil(timer.sec_remain);
-    sprintf(spiderman, "%02d:%02d", display_secs / 60, display_secs % 60);
-    SDL_Color white = {255, 255, 255, 255};
-    update_cached_text(font_large, &time_cache, spiderman, white);
-
-    float alpha = 1.0f;
-    if (timer.paused) {
-      alpha = 0.7f + 0.3f * sin(now * 0.005f);
-    }
-    draw_cached_text(&time_cache, ww / 2.0f, wh / 2.0f - 10, true, alpha);
-
-    // label
-    char label[64];
-    if (timer.is_away) {
-      strcpy(label, "AWAY? FOCUS!");
-    } else if (timer.paused) {
-      strcpy(label, "PAUSED");
-    } else if (timer.state == w) {
-      sprintf(label, "GOOD BOY :3 Session #%d", timer.session_count + 1);
-    } else {
-      strcpy(label, "BREAK! ENJOY");
+
+    char spiderman[16], label[64];
+    format_main_text(&timer, spiderman, label);
+
+    // nothing to show while hidden, and no point redrawing the same frame
+    // again unless the pulse or shake is animating it
+    bool animating = anim_active(&timer.anim, ANIM_PULSE) ||
+                     anim_active(&timer.anim, ANIM_SHAKE_X);
+    if (visible && (redraw || animating || strcmp(spiderman, drawn_time) ||
+                    strcmp(label, drawn_label))) {
+      redraw = false;
+      strcpy(drawn_time, spiderman);
+      strcpy(drawn_label, label);
+
+      render_main_view(&timer, &ring_geo, &atlas, spiderman, label, now);
+      SDL_GL_SwapWindow(window);
+      if (!first_frame) {
+        first_frame = true;
+        startup_mark("first frame", mono_now());
+        if (text_ready)
+          print_startup_timings();
+      }
+      text_shown = text_shown || text_ready;
     }
-    SDL_Color gray = {191, 199, 230, 230};
-    update_cached_text(font_small, &label_cache, label, gray);
-    draw_cached_text(&label_cache, ww / 2.0f, wh / 2.0f + 25, true, 1.0f);
-    SDL_GL_SwapWindow(window);
+    // not until the text is on screen, so opening the device never holds
+    // up the window or the first readable frame. hidden, there's no frame.
+    if (text_shown || !visible)
+      sync_audio(&timer, now);
+    anim_update(&timer.anim, now);
   }
-  if (time_cache.texture)
-    glDeleteTextures(1, &time_cache.texture);
-  if (label_cache.texture)
-    glDeleteTextures(1, &label_cache.texture);
-  if (timer.music) {
-    Mix_FreeMusic(timer.music);
-  }
-  Mix_CloseAudio();
-  TTF_CloseFont(font_large);
-  TTF_CloseFont(font_medium);
-  TTF_CloseFont(font_small);
+  stop_config_watcher();
+  stop_idle_monitor();
+  close_status_page();
+  free_countdowns();
+  stop_hook_runner();
+  stop_config_writer();
+  close_journal();
+  free_ring_geometry(&ring_geo);
+  free_glyph_atlas(&atlas);
+  history_free(&timer.streak.history);
+  shutdown_audio(&timer);
+  free_assets();
   TTF_Quit();
   SDL_GL_DeleteContext(context);
   SDL_DestroyWindow(window);
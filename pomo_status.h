@@ -0,0 +1,140 @@
+// Shared-memory status page for status bars (waybar, polybar, tmux, ...).
+//
+// A running pomopomo keeps a PomoStatus mapped at pomo_status_path() and
+// updates it in place under a seqlock, so reading it costs a couple of
+// loads: no syscalls on the timer side, no process spawn on yours.
+//
+//   PomoStatusReader r;
+//   PomoStatus st;
+//   if (pomo_status_open(&r) && pomo_status_read(&r, &st))
+//     printf("%.0f s left\n", pomo_status_remaining(&st));
+//
+// Header only; needs C11 atomics.
+#ifndef POMO_STATUS_H
+#define POMO_STATUS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define POMO_STATUS_MAGIC 0x4f4d4f50 // "POMO"
+#define POMO_STATUS_VERSION 1
+#define POMO_STATUS_MAX_TRIES 1000 // a writer stuck mid-update longer is dead
+
+enum { POMO_PHASE_WORK, POMO_PHASE_BREAK, POMO_PHASE_LONG_BREAK };
+
+enum {
+  POMO_STATUS_PAUSED = 1 << 0,
+  POMO_STATUS_AWAY = 1 << 1,
+  POMO_STATUS_EXITED = 1 << 2, // the process is gone, the rest is stale
+};
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  _Atomic uint32_t seq; // odd while the writer is mid-update
+  uint32_t pid;
+  uint32_t phase; // POMO_PHASE_*
+  uint32_t flags; // POMO_STATUS_*
+  double sec_remain;   // as of updated_ns
+  uint64_t updated_ns; // CLOCK_MONOTONIC
+  int32_t session_count;  // since the process started
+  int32_t daily_sessions; // finished today
+  int32_t consecutive_days;
+  uint32_t reserved[5];
+} PomoStatus;
+
+typedef struct {
+  const PomoStatus *page;
+} PomoStatusReader;
+
+static inline uint64_t pomo_status_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// $XDG_RUNTIME_DIR/pomopomo.status, or /tmp/pomopomo-<uid>.status.
+static inline void pomo_status_path(char *buf, size_t len) {
+  const char *dir = getenv("XDG_RUNTIME_DIR");
+  if (dir && *dir)
+    snprintf(buf, len, "%s/pomopomo.status", dir);
+  else
+    snprintf(buf, len, "/tmp/pomopomo-%u.status", (unsigned)getuid());
+}
+
+// Maps the page read-only. Keep the reader around and call
+// pomo_status_read() as often as you like.
+static inline bool pomo_status_open(PomoStatusReader *r) {
+  char path[512];
+  pomo_status_path(path, sizeof(path));
+  r->page = NULL;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  void *p = mmap(NULL, sizeof(PomoStatus), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return false;
+  r->page = p;
+  if (r->page->magic != POMO_STATUS_MAGIC ||
+      r->page->version != POMO_STATUS_VERSION) {
+    munmap(p, sizeof(PomoStatus));
+    r->page = NULL;
+    return false;
+  }
+  return true;
+}
+
+static inline void pomo_status_close(PomoStatusReader *r) {
+  if (r->page)
+    munmap((void *)r->page, sizeof(PomoStatus));
+  r->page = NULL;
+}
+
+// Takes a consistent snapshot, retrying (and yielding) while the writer is
+// mid-update. False if there's no page, the timer has exited or was killed
+// without getting to say so, or the page never settled.
+static inline bool pomo_status_read(const PomoStatusReader *r,
+                                    PomoStatus *out) {
+  if (!r->page)
+    return false;
+  PomoStatus *page = (PomoStatus *)r->page;
+  for (int tries = 0;; tries++) {
+    if (tries == POMO_STATUS_MAX_TRIES)
+      return false;
+    if (tries > 0)
+      sched_yield();
+    uint32_t before = atomic_load_explicit(&page->seq, memory_order_acquire);
+    if (before & 1)
+      continue;
+    memcpy(out, (const void *)page, sizeof(*out));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&page->seq, memory_order_relaxed) == before)
+      break;
+  }
+  if (out->flags & POMO_STATUS_EXITED)
+    return false;
+  // EPERM means it's there, just not ours to signal
+  return kill((pid_t)out->pid, 0) == 0 || errno != ESRCH;
+}
+
+// Seconds left in the phase right now, extrapolated from the snapshot.
+static inline double pomo_status_remaining(const PomoStatus *st) {
+  double remain = st->sec_remain;
+  if (!(st->flags & POMO_STATUS_PAUSED))
+    remain -= (pomo_status_now_ns() - st->updated_ns) / 1e9;
+  return remain > 0 ? remain : 0;
+}
+
+#endif